@@ -0,0 +1,109 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_DITHER_H_
+#define MC1_DITHER_H_
+
+#include <mc1/framebuffer.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Conversion of RGBA8888 pixels to lower precision pixel formats, using ordered (4x4 Bayer matrix)
+// dithering.
+//
+// The dither pattern is anchored to the destination pixel coordinates, so that a partial update of
+// an image gives the same result as converting the entire image.
+//--------------------------------------------------------------------------------------------------
+
+/// @brief Number of bits per color component in an inverse palette lookup cube.
+#define DITHER_IPAL_BITS 5
+
+/// @brief An inverse palette lookup cube.
+///
+/// The cube maps a 15-bit RGB color to the index of the closest palette color. It is about 32 KB
+/// in size, so it is best allocated on the heap.
+typedef struct {
+  uint8_t index[1 << (3 * DITHER_IPAL_BITS)];  ///< Palette indices (r + g * 32 + b * 1024).
+  int dither_shift;                            ///< log2 of the dither amplitude (3-8).
+} dither_ipal_t;
+
+/// @brief Initialize an inverse palette lookup cube.
+///
+/// The alpha channel of the palette colors is ignored. This is a fairly expensive operation
+/// (proportional to the number of palette colors), so it should only be done once per palette.
+/// @param ipal The inverse palette lookup cube to initialize.
+/// @param palette The palette colors (RGBA8888).
+/// @param num_colors Number of palette colors (1-256).
+void dither_init_ipal(dither_ipal_t* ipal, const uint32_t* palette, int num_colors);
+
+/// @brief Convert a row of RGBA8888 pixels to RGBA5551.
+/// @param[out] dst The destination pixels.
+/// @param src The source pixels.
+/// @param count Number of pixels to convert.
+/// @param x The x coordinate of the first destination pixel (used for the dither pattern).
+/// @param y The y coordinate of the destination row (used for the dither pattern).
+void dither_row_rgba5551(uint16_t* dst, const uint32_t* src, int count, int x, int y);
+
+/// @brief Convert a row of RGBA8888 pixels to 8-bit palette indices.
+/// @param[out] dst The destination pixels.
+/// @param src The source pixels.
+/// @param count Number of pixels to convert.
+/// @param x The x coordinate of the first destination pixel (used for the dither pattern).
+/// @param y The y coordinate of the destination row (used for the dither pattern).
+/// @param ipal The inverse palette lookup cube.
+void dither_row_pal8(uint8_t* dst,
+                     const uint32_t* src,
+                     int count,
+                     int x,
+                     int y,
+                     const dither_ipal_t* ipal);
+
+/// @brief Convert a rectangle of RGBA8888 pixels and draw them to a framebuffer.
+///
+/// The pixels are converted to the color mode of the framebuffer. The clip rectangle of the
+/// framebuffer is honored.
+/// @param fb The destination framebuffer.
+/// @param x The destination x coordinate.
+/// @param y The destination y coordinate.
+/// @param src The source pixels (RGBA8888).
+/// @param src_stride Number of bytes between two source rows.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+/// @param ipal The inverse palette lookup cube (only used for palette color modes).
+void dither_to_fb(fb_t* fb,
+                  int x,
+                  int y,
+                  const uint32_t* src,
+                  size_t src_stride,
+                  int w,
+                  int h,
+                  const dither_ipal_t* ipal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_DITHER_H_
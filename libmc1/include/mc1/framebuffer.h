@@ -30,6 +30,17 @@
 extern "C" {
 #endif
 
+/// @brief Maximum number of pushed clip rectangles (see fb_push_clip()).
+#define FB_CLIP_STACK_SIZE 8
+
+/// @brief A rectangle, given as the half-open ranges [x0, x1) and [y0, y1).
+typedef struct {
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+} fb_rect_t;
+
 typedef struct {
   void* pixels;
   uint32_t* vcp;
@@ -38,6 +49,13 @@ typedef struct {
   int width;
   int height;
   int mode;
+
+  // Drawing state (used by the gfx_* functions).
+  fb_rect_t clip;                            ///< Current clip rectangle.
+  int clip_depth;                            ///< Number of pushed clip rectangles.
+  fb_rect_t clip_stack[FB_CLIP_STACK_SIZE];  ///< Pushed clip rectangles.
+  fb_rect_t dirty;                           ///< Bounding rectangle of modified pixels.
+  int blend;                                 ///< Blend mode (GFX_BLEND_*).
 } fb_t;
 
 /// @brief Create a new framebuffer.
@@ -48,6 +66,18 @@ typedef struct {
 /// created.
 fb_t* fb_create(int width, int height, int mode);
 
+/// @brief Create a new offscreen framebuffer.
+///
+/// An offscreen framebuffer is allocated on the heap (i.e. in XRAM for applications that run from
+/// XRAM) instead of in VRAM, and can therefore not be shown. It has no palette, and it can be used
+/// with all the gfx_* functions. Use fb_present() to copy pixels to a framebuffer in VRAM.
+/// @param width The width of the framebuffer.
+/// @param height The height of the framebuffer.
+/// @param mode The color mode.
+/// @returns a framebuffer object, or NULL if the framebuffer could not be
+/// created.
+fb_t* fb_create_offscreen(int width, int height, int mode);
+
 /// @brief Free a framebuffer and associated memory.
 /// @param fb The framebuffer object.
 void fb_destroy(fb_t* fb);
@@ -55,8 +85,65 @@ void fb_destroy(fb_t* fb);
 /// @brief Show the framebuffer (i.e. make it current).
 /// @param fb The framebuffer object.
 /// @param layer The layer to use for the framebuffer (1 or 2).
+/// @note Offscreen framebuffers can not be shown.
 void fb_show(fb_t* fb, layer_t layer);
 
+/// @brief Reset the clip rectangle to the entire framebuffer, and clear the clip stack.
+/// @param fb The framebuffer object.
+void fb_reset_clip(fb_t* fb);
+
+/// @brief Push the current clip rectangle to the clip stack, and intersect the clip rectangle
+/// with the given rectangle.
+/// @param fb The framebuffer object.
+/// @param x Rectangle origin x coordinate.
+/// @param y Rectangle origin y coordinate.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+/// @returns a non-zero value on success, or zero if the clip stack is full (in which case the clip
+/// rectangle is left unchanged).
+int fb_push_clip(fb_t* fb, int x, int y, int w, int h);
+
+/// @brief Restore the clip rectangle that was active before the last call to fb_push_clip().
+/// @param fb The framebuffer object.
+void fb_pop_clip(fb_t* fb);
+
+/// @brief Intersect the current clip rectangle with the given rectangle (without pushing).
+/// @param fb The framebuffer object.
+/// @param x Rectangle origin x coordinate.
+/// @param y Rectangle origin y coordinate.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+void fb_intersect_clip(fb_t* fb, int x, int y, int w, int h);
+
+/// @brief Add a rectangle to the dirty rectangle of the framebuffer.
+///
+/// The gfx_* functions automatically add the pixels that they draw to the dirty rectangle. This
+/// function can be used for marking pixels that are modified by other means.
+/// @param fb The framebuffer object.
+/// @param x Rectangle origin x coordinate.
+/// @param y Rectangle origin y coordinate.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+void fb_add_dirty(fb_t* fb, int x, int y, int w, int h);
+
+/// @brief Clear the dirty rectangle of the framebuffer.
+/// @param fb The framebuffer object.
+void fb_clear_dirty(fb_t* fb);
+
+/// @brief Copy a rectangle of pixels from one framebuffer to another.
+///
+/// This is typically used for copying the modified parts of an offscreen framebuffer to a
+/// framebuffer in VRAM. The source pixel (x, y) is copied to (dx + x, dy + y) in the destination
+/// framebuffer. The copy honors the clip rectangle of the destination framebuffer, but not its
+/// blend mode.
+/// @param src The source framebuffer.
+/// @param rect The source rectangle to copy, or NULL to copy the dirty rectangle of @c src (which
+/// is then cleared).
+/// @param dst The destination framebuffer (must have the same color mode as @c src).
+/// @param dx Destination x offset.
+/// @param dy Destination y offset.
+void fb_present(fb_t* src, const fb_rect_t* rect, fb_t* dst, int dx, int dy);
+
 #ifdef __cplusplus
 }
 #endif
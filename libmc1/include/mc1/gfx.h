@@ -23,13 +23,50 @@
 
 #include <mc1/framebuffer.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Blit flags.
+#define GFX_BLIT_BOX  0x0001  ///< Use a 2x2 box filter (RGBA8888 and RGBA5551 only).
+#define GFX_BLIT_WRAP 0x0002  ///< Wrap (repeat) the source image.
+
+// Text flags.
+#define GFX_TEXT_TRANSPARENT 0x0001  ///< Do not draw the background color.
+
+// Blend modes (see gfx_set_blend()).
+#define GFX_BLEND_NONE     0  ///< Replace the destination pixels (default).
+#define GFX_BLEND_OVER     1  ///< Source over: src * src.a + dst * (1 - src.a).
+#define GFX_BLEND_ADD      2  ///< Additive: dst + src * src.a (saturated).
+#define GFX_BLEND_MULTIPLY 3  ///< Multiply: dst * src (the source alpha is ignored).
+
+/// @brief A list of recorded drawing commands.
+///
+/// Commands are recorded with the gfx_cmd_* functions, and are drawn with gfx_cmdlist_execute().
+/// A command list can be executed any number of times.
+typedef struct {
+  uint8_t* buf;  ///< Command buffer (provided by the caller).
+  size_t size;   ///< Size of the command buffer (in bytes).
+  size_t used;   ///< Number of used bytes in the command buffer.
+  size_t last;   ///< Offset of the last recorded command (internal).
+  int overflow;  ///< Non-zero if one or more commands did not fit in the command buffer.
+} gfx_cmdlist_t;
+
+/// @brief Set the blend mode of a framebuffer.
+///
+/// The blend mode is used by gfx_fill_rect(), gfx_blit(), gfx_draw_text() and the shape functions
+/// (circles, ellipses, arcs, rounded rectangles and thick lines) for the RGBA8888 and RGBA5551
+/// color modes, and is ignored for palette color modes. In RGBA5551 mode the alpha is one bit,
+/// i.e. source pixels are either opaque or fully transparent.
+/// @param blend The blend mode (GFX_BLEND_*).
+void gfx_set_blend(fb_t* fb, int blend);
+
 /// @brief Clear framebuffer.
+///
+/// The blend mode is ignored (i.e. all pixels inside the clip rectangle are set to the color).
 /// @param color The fill color.
 void gfx_clear(fb_t* fb, uint32_t color);
 
@@ -55,6 +92,229 @@ void gfx_draw_point(fb_t* fb, int x, int y, uint32_t color);
 /// @param color The line color.
 void gfx_draw_line(fb_t* fb, int x0, int y0, int x1, int y1, uint32_t color);
 
+/// @brief Draw a line with a given width.
+///
+/// The line has square ends at the end points. A width of one pixel or less draws a regular line
+/// (see gfx_draw_line()).
+/// @param x0 Line start x coordinate.
+/// @param y0 Line start y coordinate.
+/// @param x1 Line stop x coordinate.
+/// @param y1 Line stop y coordinate.
+/// @param width The line width (in pixels).
+/// @param color The line color.
+void gfx_draw_thick_line(fb_t* fb, int x0, int y0, int x1, int y1, int width, uint32_t color);
+
+/// @brief Draw the outline of a circle.
+/// @param cx Center x coordinate.
+/// @param cy Center y coordinate.
+/// @param r Radius.
+/// @param color The line color.
+void gfx_draw_circle(fb_t* fb, int cx, int cy, int r, uint32_t color);
+
+/// @brief Draw a filled circle.
+/// @param cx Center x coordinate.
+/// @param cy Center y coordinate.
+/// @param r Radius.
+/// @param color The fill color.
+void gfx_fill_circle(fb_t* fb, int cx, int cy, int r, uint32_t color);
+
+/// @brief Draw the outline of an axis aligned ellipse.
+/// @param cx Center x coordinate.
+/// @param cy Center y coordinate.
+/// @param rx Horizontal radius.
+/// @param ry Vertical radius.
+/// @param color The line color.
+void gfx_draw_ellipse(fb_t* fb, int cx, int cy, int rx, int ry, uint32_t color);
+
+/// @brief Draw a filled axis aligned ellipse.
+/// @param cx Center x coordinate.
+/// @param cy Center y coordinate.
+/// @param rx Horizontal radius.
+/// @param ry Vertical radius.
+/// @param color The fill color.
+void gfx_fill_ellipse(fb_t* fb, int cx, int cy, int rx, int ry, uint32_t color);
+
+/// @brief Draw a circular arc.
+///
+/// Angles are given in radians, where 0 is along the positive x axis and angles increase towards
+/// the positive y axis (i.e. clockwise on the screen). The arc is drawn from the start angle to the
+/// end angle.
+/// @param cx Center x coordinate.
+/// @param cy Center y coordinate.
+/// @param r Radius.
+/// @param start Start angle.
+/// @param end End angle (must be greater than or equal to the start angle).
+/// @param color The line color.
+void gfx_draw_arc(fb_t* fb, int cx, int cy, int r, float start, float end, uint32_t color);
+
+/// @brief Draw the outline of a rectangle with rounded corners.
+/// @param x Rectangle origin x coordinate.
+/// @param y Rectangle origin y coordinate.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+/// @param r Corner radius (limited to fit the rectangle).
+/// @param color The line color.
+void gfx_draw_round_rect(fb_t* fb, int x, int y, int w, int h, int r, uint32_t color);
+
+/// @brief Draw a filled rectangle with rounded corners.
+/// @param x Rectangle origin x coordinate.
+/// @param y Rectangle origin y coordinate.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+/// @param r Corner radius (limited to fit the rectangle).
+/// @param color The fill color.
+void gfx_fill_round_rect(fb_t* fb, int x, int y, int w, int h, int r, uint32_t color);
+
+/// @brief Copy a rectangle from another framebuffer.
+///
+/// The source and destination framebuffers may be the same (e.g. for scrolling).
+/// @param dx Destination x coordinate.
+/// @param dy Destination y coordinate.
+/// @param src The source framebuffer (must have the same color mode as @c fb).
+/// @param sx Source rectangle x coordinate.
+/// @param sy Source rectangle y coordinate.
+/// @param w Rectangle width.
+/// @param h Rectangle height.
+void gfx_blit(fb_t* fb, int dx, int dy, const fb_t* src, int sx, int sy, int w, int h);
+
+/// @brief Draw a scaled copy of a rectangle from another framebuffer.
+///
+/// The source rectangle is stretched to fill the destination rectangle. Pixels are sampled at the
+/// nearest source pixel, or with a 2x2 box filter if the GFX_BLIT_BOX flag is given (the filter is
+/// ignored for palette modes). Destination pixels that map to the outside of the source
+/// framebuffer are left untouched.
+/// @param dx Destination rectangle x coordinate.
+/// @param dy Destination rectangle y coordinate.
+/// @param dw Destination rectangle width.
+/// @param dh Destination rectangle height.
+/// @param src The source framebuffer (must have the same color mode as @c fb).
+/// @param sx Source rectangle x coordinate.
+/// @param sy Source rectangle y coordinate.
+/// @param sw Source rectangle width.
+/// @param sh Source rectangle height.
+/// @param flags Blit flags (GFX_BLIT_BOX).
+void gfx_blit_scaled(fb_t* fb,
+                     int dx,
+                     int dy,
+                     int dw,
+                     int dh,
+                     const fb_t* src,
+                     int sx,
+                     int sy,
+                     int sw,
+                     int sh,
+                     uint32_t flags);
+
+/// @brief Draw an affine transformed copy of another framebuffer.
+///
+/// For every pixel in the destination rectangle, the source pixel is found by transforming the
+/// pixel center (x, y), relative to the destination rectangle origin, by the 2x3 matrix:
+///
+///   u = m[0] * x + m[1] * y + m[2]
+///   v = m[3] * x + m[4] * y + m[5]
+///
+/// With the GFX_BLIT_WRAP flag, the source image is repeated (this requires that the source
+/// width and height are powers of two). Otherwise pixels that map to the outside of the source
+/// image are left untouched.
+/// @param dx Destination rectangle x coordinate.
+/// @param dy Destination rectangle y coordinate.
+/// @param dw Destination rectangle width.
+/// @param dh Destination rectangle height.
+/// @param src The source framebuffer (must have the same color mode as @c fb).
+/// @param m The 2x3 transformation matrix (6 floats, row-major).
+/// @param flags Blit flags (GFX_BLIT_WRAP).
+void gfx_blit_affine(fb_t* fb,
+                     int dx,
+                     int dy,
+                     int dw,
+                     int dh,
+                     const fb_t* src,
+                     const float* m,
+                     uint32_t flags);
+
+/// @brief Draw text using the built in 8x8 font.
+///
+/// Each character occupies an 8x8 pixel cell. A newline character moves to the start of the next
+/// line (8 pixels down, at the original x coordinate).
+/// @param x Text origin x coordinate (left edge of the first character).
+/// @param y Text origin y coordinate (top edge of the first character).
+/// @param text The zero terminated text string.
+/// @param fg The foreground (text) color.
+/// @param bg The background color.
+/// @param flags Text flags (GFX_TEXT_TRANSPARENT).
+void gfx_draw_text(fb_t* fb,
+                   int x,
+                   int y,
+                   const char* text,
+                   uint32_t fg,
+                   uint32_t bg,
+                   uint32_t flags);
+
+/// @brief Initialize a command list.
+/// @param cl The command list.
+/// @param buf The command buffer (must be aligned to the size of a pointer).
+/// @param size The size of the command buffer (in bytes).
+void gfx_cmdlist_init(gfx_cmdlist_t* cl, void* buf, size_t size);
+
+/// @brief Remove all commands from a command list.
+/// @param cl The command list.
+void gfx_cmdlist_clear(gfx_cmdlist_t* cl);
+
+/// @brief Record a gfx_fill_rect() command.
+///
+/// If the rectangle and the previously recorded fill together form a single rectangle of the same
+/// color, the two commands are merged into one.
+void gfx_cmd_fill_rect(gfx_cmdlist_t* cl, int x0, int y0, int w, int h, uint32_t color);
+
+/// @brief Record a gfx_draw_point() command.
+void gfx_cmd_draw_point(gfx_cmdlist_t* cl, int x, int y, uint32_t color);
+
+/// @brief Record a gfx_draw_line() command.
+void gfx_cmd_draw_line(gfx_cmdlist_t* cl, int x0, int y0, int x1, int y1, uint32_t color);
+
+/// @brief Record a gfx_blit_scaled() command.
+/// @note The source framebuffer must be valid when the command list is executed.
+void gfx_cmd_blit_scaled(gfx_cmdlist_t* cl,
+                         int dx,
+                         int dy,
+                         int dw,
+                         int dh,
+                         const fb_t* src,
+                         int sx,
+                         int sy,
+                         int sw,
+                         int sh,
+                         uint32_t flags);
+
+/// @brief Record a gfx_draw_text() command.
+/// @note The text is copied into the command list.
+void gfx_cmd_draw_text(gfx_cmdlist_t* cl,
+                       int x,
+                       int y,
+                       const char* text,
+                       uint32_t fg,
+                       uint32_t bg,
+                       uint32_t flags);
+
+/// @brief Record a gfx_set_blend() command.
+/// @note The blend mode of the framebuffer is restored when the command list has been executed.
+void gfx_cmd_set_blend(gfx_cmdlist_t* cl, int blend);
+
+/// @brief Record an fb_push_clip() command.
+void gfx_cmd_push_clip(gfx_cmdlist_t* cl, int x, int y, int w, int h);
+
+/// @brief Record an fb_pop_clip() command.
+void gfx_cmd_pop_clip(gfx_cmdlist_t* cl);
+
+/// @brief Draw all the commands of a command list.
+///
+/// The result is the same as calling the corresponding gfx_* functions in the recorded order, but
+/// the framebuffer is processed in bands of rows (for memory locality), and the color mode
+/// dispatch is done once for the entire list.
+/// @param cl The command list.
+/// @param fb The framebuffer to draw to.
+void gfx_cmdlist_execute(const gfx_cmdlist_t* cl, fb_t* fb);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,511 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2020 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_GLYPH_FONT_H_
+#define MC1_GLYPH_FONT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mc1 {
+namespace glyph_font {
+
+// The built in vector font, shared by glyph_renderer_t and the SDF atlas generator (sdffont).
+//
+// Each glyph is a list of points on an 8x8 grid, packed into one byte each with the point kind in
+// the two most significant bits. PNT_BEZIER marks the control point of a quadratic Bézier curve,
+// PNT_END ends a stroke and PNT_LAST ends the glyph. The glyph list is terminated by a zero byte.
+enum point_kind_t { PNT_REGULAR = 0, PNT_BEZIER = 1, PNT_END = 2, PNT_LAST = 3 };
+
+inline constexpr uint8_t PP(const uint8_t x, const uint8_t y, const point_kind_t kind) {
+  return static_cast<uint8_t>(((static_cast<uint8_t>(kind) & 3u) << 6) | ((x & 7u) << 3) | (y & 7));
+}
+
+inline constexpr uint8_t FONT[] = {'A',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 6, PNT_END),
+                                   PP(2, 4, PNT_REGULAR),
+                                   PP(4, 4, PNT_LAST),
+
+                                   'B',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(5, 0, PNT_BEZIER),
+                                   PP(5, 2, PNT_REGULAR),
+                                   PP(5, 3, PNT_BEZIER),
+                                   PP(3, 3, PNT_END),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(3, 3, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(6, 5, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(4, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_LAST),
+
+                                   'C',
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(4, 0, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(0, 3, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(4, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   'D',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 3, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(0, 6, PNT_LAST),
+
+                                   'E',
+                                   PP(6, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_END),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(4, 3, PNT_LAST),
+
+                                   'F',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_END),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(4, 3, PNT_LAST),
+
+                                   'G',
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(4, 0, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(0, 3, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(4, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_REGULAR),
+                                   PP(6, 3, PNT_REGULAR),
+                                   PP(3, 3, PNT_LAST),
+
+                                   'H',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(0, 6, PNT_END),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(6, 6, PNT_END),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(5, 3, PNT_LAST),
+
+                                   'I',
+                                   PP(2, 0, PNT_REGULAR),
+                                   PP(4, 0, PNT_END),
+                                   PP(2, 6, PNT_REGULAR),
+                                   PP(4, 6, PNT_END),
+                                   PP(3, 1, PNT_REGULAR),
+                                   PP(3, 5, PNT_LAST),
+
+                                   'J',
+                                   PP(1, 0, PNT_REGULAR),
+                                   PP(5, 0, PNT_REGULAR),
+                                   PP(5, 4, PNT_REGULAR),
+                                   PP(5, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(1, 6, PNT_BEZIER),
+                                   PP(1, 4, PNT_LAST),
+
+                                   'K',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(0, 6, PNT_END),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   'L',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   'M',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(3, 4, PNT_REGULAR),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   'N',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 6, PNT_REGULAR),
+                                   PP(6, 0, PNT_LAST),
+
+                                   'O',
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 3, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 3, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_LAST),
+
+                                   'P',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 1, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(1, 3, PNT_LAST),
+
+                                   'Q',
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 3, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 3, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_END),
+                                   PP(3, 4, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   'R',
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 1, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(1, 3, PNT_END),
+                                   PP(2, 3, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   'S',
+                                   PP(6, 1, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(0, 1, PNT_REGULAR),
+                                   PP(0, 3, PNT_BEZIER),
+                                   PP(3, 3, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(6, 5, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 5, PNT_LAST),
+
+                                   'T',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_END),
+                                   PP(3, 1, PNT_REGULAR),
+                                   PP(3, 6, PNT_LAST),
+
+                                   'U',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(0, 3, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(6, 3, PNT_REGULAR),
+                                   PP(6, 0, PNT_LAST),
+
+                                   'V',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(6, 0, PNT_LAST),
+
+                                   'W',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(1, 6, PNT_REGULAR),
+                                   PP(3, 3, PNT_REGULAR),
+                                   PP(5, 6, PNT_REGULAR),
+                                   PP(6, 0, PNT_LAST),
+
+                                   'X',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 6, PNT_END),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(0, 6, PNT_LAST),
+
+                                   'Y',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(3, 4, PNT_REGULAR),
+                                   PP(3, 6, PNT_END),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(3, 4, PNT_LAST),
+
+                                   'Z',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_END),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(5, 3, PNT_LAST),
+
+                                   '0',
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 3, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 3, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_END),
+                                   PP(3, 2, PNT_REGULAR),
+                                   PP(3, 4, PNT_LAST),
+
+                                   '1',
+                                   PP(1, 2, PNT_REGULAR),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(3, 6, PNT_LAST),
+
+                                   '2',
+                                   PP(0, 1, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 1, PNT_REGULAR),
+                                   PP(6, 2, PNT_BEZIER),
+                                   PP(4, 3, PNT_REGULAR),
+                                   PP(0, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_LAST),
+
+                                   '3',
+                                   PP(0, 1, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 1, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(3, 3, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(6, 5, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 5, PNT_LAST),
+
+                                   '4',
+                                   PP(6, 4, PNT_REGULAR),
+                                   PP(0, 4, PNT_REGULAR),
+                                   PP(5, 0, PNT_REGULAR),
+                                   PP(5, 6, PNT_LAST),
+
+                                   '5',
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(0, 2, PNT_REGULAR),
+                                   PP(2, 2, PNT_REGULAR),
+                                   PP(6, 2, PNT_BEZIER),
+                                   PP(6, 4, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 5, PNT_LAST),
+
+                                   '6',
+                                   PP(5, 0, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(0, 4, PNT_REGULAR),
+                                   PP(0, 3, PNT_BEZIER),
+                                   PP(3, 3, PNT_REGULAR),
+                                   PP(6, 3, PNT_BEZIER),
+                                   PP(6, 4, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 3, PNT_LAST),
+
+                                   '7',
+                                   PP(0, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(4, 2, PNT_REGULAR),
+                                   PP(2, 3, PNT_BEZIER),
+                                   PP(2, 6, PNT_END),
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(5, 3, PNT_LAST),
+
+                                   '8',
+                                   PP(3, 2, PNT_REGULAR),
+                                   PP(1, 2, PNT_BEZIER),
+                                   PP(1, 1, PNT_REGULAR),
+                                   PP(1, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(5, 0, PNT_BEZIER),
+                                   PP(5, 1, PNT_REGULAR),
+                                   PP(5, 2, PNT_BEZIER),
+                                   PP(3, 2, PNT_REGULAR),
+                                   PP(6, 2, PNT_BEZIER),
+                                   PP(6, 4, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(0, 6, PNT_BEZIER),
+                                   PP(0, 4, PNT_REGULAR),
+                                   PP(0, 2, PNT_BEZIER),
+                                   PP(3, 2, PNT_LAST),
+
+                                   '9',
+                                   PP(1, 6, PNT_REGULAR),
+                                   PP(6, 6, PNT_BEZIER),
+                                   PP(6, 2, PNT_REGULAR),
+                                   PP(6, 4, PNT_BEZIER),
+                                   PP(3, 4, PNT_REGULAR),
+                                   PP(0, 4, PNT_BEZIER),
+                                   PP(0, 2, PNT_REGULAR),
+                                   PP(0, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 3, PNT_LAST),
+
+                                   ',',
+                                   PP(3, 5, PNT_REGULAR),
+                                   PP(2, 6, PNT_LAST),
+
+                                   '.',
+                                   PP(2, 6, PNT_REGULAR),
+                                   PP(2, 6, PNT_LAST),
+
+                                   '!',
+                                   PP(2, 0, PNT_REGULAR),
+                                   PP(2, 4, PNT_END),
+                                   PP(2, 6, PNT_REGULAR),
+                                   PP(2, 6, PNT_LAST),
+
+                                   '?',
+                                   PP(1, 1, PNT_REGULAR),
+                                   PP(1, 0, PNT_BEZIER),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(6, 0, PNT_BEZIER),
+                                   PP(6, 2, PNT_REGULAR),
+                                   PP(6, 4, PNT_BEZIER),
+                                   PP(3, 4, PNT_REGULAR),
+                                   PP(3, 5, PNT_END),
+                                   PP(3, 6, PNT_REGULAR),
+                                   PP(3, 6, PNT_LAST),
+
+                                   ':',
+                                   PP(2, 1, PNT_REGULAR),
+                                   PP(2, 1, PNT_END),
+                                   PP(2, 5, PNT_REGULAR),
+                                   PP(2, 5, PNT_LAST),
+
+                                   '"',
+                                   PP(2, 0, PNT_REGULAR),
+                                   PP(2, 1, PNT_END),
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(3, 1, PNT_LAST),
+
+                                   '\'',
+                                   PP(3, 0, PNT_REGULAR),
+                                   PP(2, 1, PNT_LAST),
+
+                                   '+',
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(5, 3, PNT_END),
+                                   PP(3, 1, PNT_REGULAR),
+                                   PP(3, 5, PNT_LAST),
+
+                                   '-',
+                                   PP(1, 3, PNT_REGULAR),
+                                   PP(5, 3, PNT_LAST),
+
+                                   '*',
+                                   PP(2, 2, PNT_REGULAR),
+                                   PP(4, 4, PNT_END),
+                                   PP(2, 4, PNT_REGULAR),
+                                   PP(4, 2, PNT_LAST),
+
+                                   '/',
+                                   PP(6, 0, PNT_REGULAR),
+                                   PP(0, 6, PNT_LAST),
+
+                                   // No more glyphs...
+                                   0};
+
+// An index of the glyphs in FONT, generated at compile time. For each character, it holds the
+// offset of the first point of the glyph, or NO_GLYPH if there is no glyph for the character, and
+// the advance width of the glyph in font grid units (1/8 of the glyph width).
+inline constexpr uint16_t NO_GLYPH = 0xffffu;
+inline constexpr uint8_t NO_GLYPH_ADVANCE = 4u;
+static_assert(sizeof(FONT) < NO_GLYPH, "FONT is too large for 16-bit offsets");
+
+struct font_index_t {
+  constexpr font_index_t() : offset(), advance() {
+    for (int c = 0; c < 256; ++c) {
+      offset[c] = NO_GLYPH;
+      advance[c] = NO_GLYPH_ADVANCE;
+    }
+    size_t pos = 0;
+    while (FONT[pos] != 0) {
+      const auto c = FONT[pos++];
+      const bool first = (offset[c] == NO_GLYPH);
+      if (first) {
+        offset[c] = static_cast<uint16_t>(pos);
+      }
+
+      // The glyph is drawn one grid unit to the right of its x coordinates, and is followed by one
+      // grid unit of spacing.
+      uint8_t max_x = 0u;
+      for (;; ++pos) {
+        const uint8_t x = (FONT[pos] >> 3) & 7u;
+        max_x = x > max_x ? x : max_x;
+        if (((FONT[pos] >> 6) & 3u) == PNT_LAST) {
+          break;
+        }
+      }
+      if (first) {
+        advance[c] = static_cast<uint8_t>(max_x + 2u);
+      }
+      ++pos;
+    }
+  }
+
+  uint16_t offset[256];
+  uint8_t advance[256];
+};
+
+inline constexpr font_index_t FONT_INDEX{};
+
+//--------------------------------------------------------------------------------------------------
+// Signed distance field atlas layout (see sdffont and sdf_font.h).
+//--------------------------------------------------------------------------------------------------
+
+/// @brief Number of glyph cells per atlas row.
+inline constexpr unsigned SDF_ATLAS_COLUMNS = 16u;
+
+/// @brief The first character in the atlas.
+inline constexpr unsigned SDF_FIRST_CHAR = 32u;
+
+/// @brief Number of characters in the atlas (SDF_FIRST_CHAR up to and including 127).
+inline constexpr unsigned SDF_NUM_CHARS = 96u;
+
+/// @brief Atlas value at the glyph edge (larger values are inside the glyph).
+inline constexpr unsigned SDF_EDGE_VALUE = 128u;
+
+/// @brief Change of the atlas value per atlas pixel of distance from the edge.
+inline constexpr unsigned SDF_DIST_SCALE = 32u;
+
+}  // namespace glyph_font
+}  // namespace mc1
+
+#endif  // MC1_GLYPH_FONT_H_
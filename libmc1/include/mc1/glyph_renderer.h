@@ -21,23 +21,116 @@
 #ifndef MC1_GLYPH_RENDERER_H_
 #define MC1_GLYPH_RENDERER_H_
 
+#include <cstddef>
 #include <cstdint>
 
 namespace mc1 {
 
 class glyph_renderer_t {
 public:
-  void init(const unsigned log2_width, const unsigned log2_height);
+  /// @brief Glyph rasterization methods.
+  enum method_t {
+    /// Draw one pixel wide strokes, that are anti-aliased by grow().
+    STROKE = 0,
+
+    /// Accumulate the exact area that the strokes cover in each pixel. The strokes are wider than
+    /// with STROKE, and grow() is a no-op.
+    COVERAGE = 1
+  };
+
+  /// @brief A kerning pair for draw_string().
+  struct kerning_pair_t {
+    char first;     ///< The left character.
+    char second;    ///< The right character.
+    int8_t adjust;  ///< Advance adjustment in font grid units (1/8 of the glyph width).
+  };
+
+  /// @brief Maximum number of characters that draw_string() lays out.
+  static constexpr unsigned MAX_STRING_LENGTH = 128;
+
+  /// @brief Initialize the renderer.
+  /// @param log2_width Glyph width (log2, at least 3).
+  /// @param log2_height Glyph height (log2, at least 3).
+  /// @param method Rasterization method.
+  /// @param log2_string_width Maximum width (log2) of strings drawn with draw_string(), or 0 if
+  /// draw_string() is not used.
+  void init(const unsigned log2_width,
+            const unsigned log2_height,
+            const method_t method = STROKE,
+            const unsigned log2_string_width = 0);
   void deinit();
 
   void draw_char(const char c);
   void grow();
 
+  /// @brief Lay out and draw a string (including the grow() pass).
+  ///
+  /// The glyphs are placed according to their advance widths (and optional kerning pairs) in a
+  /// string strip that is as high as a glyph. Characters that do not fit in the strip are dropped.
+  /// Use the paint_string_*() functions to paint the strip.
+  /// @param str The string (zero terminated).
+  /// @param kerning Kerning pairs (may be nullptr).
+  /// @param num_kerning_pairs Number of kerning pairs.
+  /// @returns the advance width of the string in pixels.
+  unsigned draw_string(const char* str,
+                       const kerning_pair_t* kerning = nullptr,
+                       const unsigned num_kerning_pairs = 0);
+
   void paint_8bpp(uint8_t* pix, const unsigned stride);
+  void paint_4bpp(uint8_t* pix, const unsigned stride);
   void paint_2bpp(uint8_t* pix, const unsigned stride);
+  void paint_1bpp(uint8_t* pix, const unsigned stride);
+
+  /// @brief Paint a coverage bitmap (e.g. from glyph_cache_t) that has the size of this renderer.
+  void paint_8bpp(const uint8_t* coverage, uint8_t* pix, const unsigned stride) const;
+  void paint_4bpp(const uint8_t* coverage, uint8_t* pix, const unsigned stride) const;
+  void paint_2bpp(const uint8_t* coverage, uint8_t* pix, const unsigned stride) const;
+  void paint_1bpp(const uint8_t* coverage, uint8_t* pix, const unsigned stride) const;
+
+  /// @brief Paint the string that was drawn by draw_string().
+  ///
+  /// string_width() pixels are painted for each row (pixels are packed with the first pixel in the
+  /// least significant bits of each byte).
+  void paint_string_8bpp(uint8_t* pix, const unsigned stride) const;
+  void paint_string_4bpp(uint8_t* pix, const unsigned stride) const;
+  void paint_string_2bpp(uint8_t* pix, const unsigned stride) const;
+  void paint_string_1bpp(uint8_t* pix, const unsigned stride) const;
+
+  unsigned log2_width() const {
+    return m_log2_width;
+  }
+  unsigned log2_height() const {
+    return m_log2_height;
+  }
+  method_t method() const {
+    return m_method;
+  }
+
+  /// @brief Get the coverage bitmap (width x height bytes) of the last drawn glyph.
+  const uint8_t* pixels() const {
+    return m_glyph.pixels;
+  }
+
+  /// @brief Get the painted width (in pixels, a multiple of 8) of the last drawn string.
+  unsigned string_width() const {
+    return m_string_width;
+  }
 
 private:
-  void draw_glyph(const uint8_t *points);
+  // A coverage buffer that glyphs are drawn to (a single glyph, or a string strip).
+  struct canvas_t {
+    uint8_t* pixels = nullptr;     // width x height coverage values.
+    uint8_t* work_rows = nullptr;  // Two rows, for grow().
+    float* accum = nullptr;        // (width + 3) x height accumulators (for COVERAGE).
+    unsigned log2_width = 0;
+    unsigned width = 0;
+  };
+
+  bool alloc_canvas(canvas_t& canvas, const unsigned log2_width);
+  void free_canvas(canvas_t& canvas);
+  void clear_canvas(canvas_t& canvas, const unsigned width);
+  void grow_canvas(canvas_t& canvas, const unsigned width);
+  void draw_glyph(const uint8_t *points, const float origin_x);
   void draw_line(const float x0, const float y0, const float x1, const float y1);
   void draw_bez3(const float x0,
                  const float y0,
@@ -45,13 +138,79 @@ private:
                  const float y1,
                  const float x2,
                  const float y2);
+  void draw_stroke(const float x0, const float y0, const float x1, const float y1);
+  void accumulate_edge(float x0, float y0, float x1, float y1);
+  void resolve_coverage(canvas_t& canvas, const unsigned width);
 
   unsigned m_log2_width;
   unsigned m_log2_height;
   unsigned m_width;
   unsigned m_height;
-  uint8_t* m_pixels;
-  uint8_t* m_work_rows;
+  method_t m_method;
+  float m_stroke_radius;
+  canvas_t m_glyph;
+  canvas_t m_strip;
+  canvas_t* m_canvas;
+  unsigned m_string_width;
+};
+
+/// @brief A cache of rendered glyphs.
+///
+/// The cache holds the final coverage bitmaps of glyphs (i.e. after draw_char() and grow()), keyed
+/// by the character, the glyph size and the rasterization method, so that repeated characters only
+/// cost a paint operation. All bitmaps are stored in one memory area of a fixed size, and the least
+/// recently used glyphs are evicted when the area is full.
+///
+/// Example:
+/// @code
+///   mc1::glyph_cache_t cache;
+///   cache.init(16384, false);
+///   ...
+///   renderer.paint_8bpp(cache.get(renderer, 'A'), pix, stride);
+/// @endcode
+class glyph_cache_t {
+public:
+  /// @brief Maximum number of glyphs in the cache.
+  static constexpr unsigned MAX_ENTRIES = 128;
+
+  /// @brief Initialize the cache.
+  /// @param budget The number of bytes to use for glyph bitmaps.
+  /// @param use_vram Allocate the memory from VRAM (true) or from the heap (false).
+  /// @returns true on success, or false if the memory could not be allocated.
+  bool init(const size_t budget, const bool use_vram);
+  void deinit();
+
+  /// @brief Evict all glyphs from the cache.
+  void clear();
+
+  /// @brief Get the coverage bitmap of a glyph.
+  ///
+  /// If the glyph is not in the cache, it is drawn with the renderer and added to the cache.
+  /// @param renderer The renderer (determines the glyph size).
+  /// @param c The character.
+  /// @returns a bitmap of the same size as the renderer, or nullptr if the glyph could not be
+  /// rendered (e.g. if it does not fit in the cache).
+  const uint8_t* get(glyph_renderer_t& renderer, const char c);
+
+private:
+  struct entry_t {
+    uint32_t key;
+    uint32_t last_use;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  int allocate(const uint32_t size);
+  void evict_lru();
+
+  uint8_t* m_memory = nullptr;
+  size_t m_budget = 0;
+  bool m_use_vram = false;
+  uint32_t m_clock = 0;
+
+  // Entries, sorted by offset.
+  entry_t m_entries[MAX_ENTRIES];
+  unsigned m_num_entries = 0;
 };
 
 }  // namespace mc1
@@ -32,6 +32,52 @@ uint32_t LZG_Decode(const uint8_t* in,
                     uint8_t* out,
                     const uint32_t outsize);
 
+/// @brief State of a resumable LZG decoder.
+///
+/// The decoder is fed with the LZG data in chunks of any size, and the decoded data is written
+/// straight to the output buffer, which also serves as the history window for back references. The
+/// only input that is buffered between calls is an incomplete header or copy token (a few bytes).
+/// All fields are internal.
+typedef struct {
+  uint8_t* out;            ///< Start of the output buffer.
+  uint8_t* dst;            ///< Current output position.
+  uint8_t* out_end;        ///< End of the output buffer.
+  uint32_t decoded_size;   ///< Decoded size (from the LZG header).
+  uint32_t encoded_left;   ///< Number of encoded bytes that have not been fed yet.
+  uint32_t checksum;       ///< Expected checksum (from the LZG header).
+  uint32_t checksum_a;     ///< Running checksum of the encoded data (low part).
+  uint32_t checksum_b;     ///< Running checksum of the encoded data (high part).
+  uint32_t prologue_size;  ///< Size of the header, including the marker symbols.
+  uint32_t num_prologue;   ///< Number of header bytes that have been fed.
+  uint32_t num_pending;    ///< Number of bytes of an incomplete copy token.
+  int error;               ///< Non-zero if the data is invalid.
+  uint8_t prologue[20];    ///< LZG header (16 bytes) and marker symbols (4 bytes).
+  uint8_t pending[4];      ///< Bytes of an incomplete copy token.
+} lzg_stream_t;
+
+/// @brief Initialize a resumable LZG decoder.
+/// @param stream The decoder state.
+/// @param out The output buffer.
+/// @param outsize The size of the output buffer.
+void LZG_StreamInit(lzg_stream_t* stream, uint8_t* out, const uint32_t outsize);
+
+/// @brief Decode a chunk of LZG data.
+/// @param stream The decoder state.
+/// @param in The next chunk of the LZG data.
+/// @param insize The size of the chunk.
+/// @returns the number of bytes that were used, which is less than @c insize only if the chunk
+/// extends past the end of the LZG data.
+uint32_t LZG_StreamFeed(lzg_stream_t* stream, const uint8_t* in, const uint32_t insize);
+
+/// @brief Get the number of bytes that have been decoded so far.
+/// @param stream The decoder state.
+uint32_t LZG_StreamDecoded(const lzg_stream_t* stream);
+
+/// @brief Check if all the LZG data has been decoded.
+/// @param stream The decoder state.
+/// @returns the decoded size, or zero if the decoding is not complete (or failed).
+uint32_t LZG_StreamDone(const lzg_stream_t* stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,219 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_MCA_PLAYER_H_
+#define MC1_MCA_PLAYER_H_
+
+#include <mc1/framebuffer.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frame types.
+#define MCA_FRAME_KEY   0  ///< The frame holds all the pixels.
+#define MCA_FRAME_DELTA 1  ///< The frame holds the pixels that differ from two frames earlier.
+
+// Header flags.
+#define MCA_FLAG_BLOCKS 1  ///< The frames are aligned to blocks (for streaming).
+
+// Block size for MCA_FLAG_BLOCKS.
+#define MCA_BLOCK_SIZE 512
+
+typedef struct {
+  uint32_t magic;            ///< Magic ID (must be 0x3141434d).
+  uint16_t width;            ///< Frame width.
+  uint16_t height;           ///< Frame height.
+  uint8_t pixel_format;      ///< Pixel format (MCI_PIXFMT_*).
+  uint8_t flags;             ///< Flags (MCA_FLAG_*).
+  uint16_t num_pal_colors;   ///< Number of palette colors.
+  uint16_t num_frames;       ///< Number of frames.
+  uint16_t frame_period;     ///< Number of video frames per animation frame.
+  uint32_t max_delta_size;   ///< Largest decoded size of a delta frame (in bytes).
+} mca_header_t;
+
+/// @brief Animation player state.
+///
+/// The player decodes the frames into two alternating framebuffers: While one framebuffer is
+/// shown, the next frame is decoded into the other framebuffer. Since that framebuffer already
+/// holds the frame from two frames earlier, a delta frame only has to update the pixels that
+/// differ from that frame.
+typedef struct {
+  const uint8_t* data;         ///< The MCA data.
+  const mca_header_t* hdr;     ///< The MCA header.
+  const uint32_t* frames;      ///< The frame table (num_frames + 1 offsets).
+  fb_t* fb[2];                 ///< The framebuffers.
+  uint8_t* delta_buf;          ///< Buffer for decoded delta frames.
+  uint32_t next_frame;         ///< The next frame to decode.
+  int back;                    ///< The framebuffer that the next frame is decoded into (0 or 1).
+} mca_player_t;
+
+/// @brief Block read callback function for streaming.
+/// @param buf The target buffer.
+/// @param first_block The first block to read (counted from the start of the MCA data).
+/// @param num_blocks The number of blocks to read.
+/// @param custom The custom data pointer that was passed to mca_stream_init().
+/// @returns a non-zero value on success, or zero if the blocks could not be read.
+typedef int (*mca_read_blocks_fun_t)(void* buf,
+                                     uint32_t first_block,
+                                     uint32_t num_blocks,
+                                     void* custom);
+
+/// @brief Streaming animation player state.
+///
+/// Only the header, the palette and the frame table are kept in memory. The compressed frames are
+/// read from a block device (e.g. an SD card) one at a time: While a frame is shown, the next frame
+/// is read in chunks of a few blocks until it is time to show it, so that reading is overlapped
+/// with the display period instead of being serialized with decoding.
+typedef struct {
+  mca_read_blocks_fun_t read_blocks;  ///< Block read function.
+  void* custom;                       ///< Custom data for the block read function.
+  uint8_t* header_buf;                ///< The header, palette and frame table.
+  const mca_header_t* hdr;            ///< The MCA header.
+  const uint32_t* frames;             ///< The frame table (num_frames + 1 offsets).
+  uint8_t* frame_buf;                 ///< Buffer for a compressed frame.
+  uint8_t* delta_buf;                 ///< Buffer for decoded delta frames.
+  fb_t* fb[2];                        ///< The framebuffers.
+  uint32_t next_frame;                ///< The next frame to decode.
+  uint32_t blocks_read;               ///< Number of blocks of the next frame in frame_buf.
+  uint32_t due_frame_no;              ///< The video frame number when the next frame is due.
+  int back;                           ///< The framebuffer that the next frame is decoded into.
+} mca_stream_t;
+
+/// @brief Get the MCA header.
+/// @param mca_data The MCA data buffer.
+/// @returns a pointer to the header, or NULL if the MCA data is invalid.
+const mca_header_t* mca_get_header(const uint8_t* mca_data);
+
+/// @brief Decode a single frame into a framebuffer.
+///
+/// Key frames are decoded directly into the framebuffer. Delta frames are decoded into
+/// @c delta_buf, and only the changed pixels are copied to the framebuffer (which must hold the
+/// frame from two frames earlier).
+/// @param hdr The MCA header.
+/// @param frame The frame data (starting with the frame type).
+/// @param size The size of the frame data (in bytes).
+/// @param fb The target framebuffer (same size and color mode as the animation).
+/// @param delta_buf A buffer for decoded delta frames (hdr->max_delta_size bytes).
+/// @returns a non-zero value on success, or zero if the frame could not be decoded.
+int mca_decode_frame(const mca_header_t* hdr,
+                     const uint8_t* frame,
+                     uint32_t size,
+                     fb_t* fb,
+                     uint8_t* delta_buf);
+
+/// @brief Start playing an animation.
+///
+/// The framebuffers are typically created with fb_create() (for showing the animation) or with
+/// fb_create_offscreen() (e.g. for sprites that are drawn with gfx_blit()). The animation palette
+/// is loaded into the framebuffers, if they have palettes.
+/// @param player The player state.
+/// @param mca_data The MCA data buffer (must be kept alive during playback).
+/// @param fb0 The first framebuffer (same size and color mode as the animation).
+/// @param fb1 The second framebuffer (same size and color mode as the animation).
+/// @returns a non-zero value on success, or zero if the MCA data is invalid, if the framebuffers
+/// do not match the animation, or if the delta buffer could not be allocated.
+int mca_player_init(mca_player_t* player, const uint8_t* mca_data, fb_t* fb0, fb_t* fb1);
+
+/// @brief Free the resources of a player (the framebuffers are not freed).
+/// @param player The player state.
+void mca_player_deinit(mca_player_t* player);
+
+/// @brief Decode the next frame.
+///
+/// The frame is decoded into the back framebuffer, which then becomes the front framebuffer. After
+/// the last frame, playback restarts from the first frame.
+///
+/// @code
+///   while (playing) {
+///     fb_t* fb = mca_player_next(&player);
+///     // ...wait for the frame period (e.g. using VIDFRAMENO)...
+///     fb_show(fb, LAYER_1);
+///   }
+/// @endcode
+/// @param player The player state.
+/// @returns the framebuffer that holds the new frame, or NULL if the frame could not be decoded.
+fb_t* mca_player_next(mca_player_t* player);
+
+/// @brief Restart playback from the first frame.
+/// @param player The player state.
+void mca_player_rewind(mca_player_t* player);
+
+/// @brief Start streaming an animation.
+///
+/// The animation must have been created with MCA_FLAG_BLOCKS (png2mci --anim --stream). The first
+/// frame is read before the function returns.
+///
+/// The read function typically reads directly from the SD card with sdcard_read() (which uses
+/// multi-block reads), e.g. for an animation that is stored in consecutive blocks:
+///
+/// @code
+///   static int read_blocks(void* buf, uint32_t first_block, uint32_t num_blocks, void* custom) {
+///     return sdcard_read(&s_sdctx, buf, MY_ANIM_FIRST_BLOCK + first_block, num_blocks) ? 1 : 0;
+///   }
+/// @endcode
+///
+/// ...or from a file, e.g. with mfat_lseek() and mfat_read().
+/// @param stream The player state.
+/// @param read_blocks The block read function.
+/// @param custom Custom data that is passed to the block read function.
+/// @param fb0 The first framebuffer (same size and color mode as the animation).
+/// @param fb1 The second framebuffer (same size and color mode as the animation).
+/// @returns a non-zero value on success, or zero if the MCA data could not be read, if it is not
+/// prepared for streaming, if the framebuffers do not match the animation, or if the buffers could
+/// not be allocated.
+int mca_stream_init(mca_stream_t* stream,
+                    mca_read_blocks_fun_t read_blocks,
+                    void* custom,
+                    fb_t* fb0,
+                    fb_t* fb1);
+
+/// @brief Free the resources of a streaming player (the framebuffers are not freed).
+/// @param stream The player state.
+void mca_stream_deinit(mca_stream_t* stream);
+
+/// @brief Decode the next frame, and wait until it is time to show it.
+///
+/// The frame is decoded into the back framebuffer. While waiting for the frame to become due
+/// (according to VIDFRAMENO and the frame period), the following frame is read from the block
+/// device. If playback falls behind (e.g. because the block device is too slow), the pace is reset
+/// rather than trying to catch up. After the last frame, playback restarts from the first frame.
+///
+/// @code
+///   while (playing) {
+///     fb_t* fb = mca_stream_next(&stream);
+///     if (fb == NULL) {
+///       break;
+///     }
+///     fb_show(fb, LAYER_1);
+///   }
+/// @endcode
+/// @param stream The player state.
+/// @returns the framebuffer that holds the new frame, or NULL if the frame could not be read or
+/// decoded.
+fb_t* mca_stream_next(mca_stream_t* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_MCA_PLAYER_H_
@@ -21,6 +21,9 @@
 #ifndef MC1_MCI_DECODE_H_
 #define MC1_MCI_DECODE_H_
 
+#include <mc1/framebuffer.h>
+#include <mc1/lzg_mc1.h>
+
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -36,8 +39,10 @@ extern "C" {
 #define MCI_PIXFMT_PAL1     5
 
 // Compression methods.
-#define MCI_COMP_NONE   0
-#define MCI_COMP_LZG    1
+#define MCI_COMP_NONE         0
+#define MCI_COMP_LZG          1
+#define MCI_COMP_LZG_INPLACE  2  ///< LZG, with a margin for in-place decoding.
+#define MCI_COMP_LZG_BANDS    3  ///< LZG, in separately compressed bands of rows.
 
 typedef struct {
   uint32_t magic;            ///< Magic ID (must be 0x3149434d).
@@ -64,6 +69,15 @@ uint32_t mci_get_stride(const mci_header_t* hdr);
 /// @returns the number of bytes that the uncompressed pixel data will occupy in memory.
 uint32_t mci_get_pixels_size(const mci_header_t* hdr);
 
+/// @brief Get the number of rows per independently decodable band of rows.
+///
+/// Rows are decoded in whole bands. For MCI_COMP_LZG_BANDS images, the band size is chosen by the
+/// encoder. Uncompressed images have one row per band, and other compressed images are a single
+/// band.
+/// @param hdr The MCI header (must be valid!).
+/// @returns the number of rows per band (the last band of the image may be shorter).
+uint32_t mci_get_band_rows(const mci_header_t* hdr);
+
 /// @brief Decode palette data from an MCI buffer.
 /// @param mci_data The MCI data buffer.
 /// @param[out] palette The target palette buffer.
@@ -74,11 +88,137 @@ void mci_decode_palette(const uint8_t* mci_data, uint32_t* palette);
 /// @param[out] pixels The target pixel buffer.
 void mci_decode_pixels(const uint8_t* mci_data, uint32_t* pixels);
 
+/// @brief Decode a range of rows from an MCI buffer.
+///
+/// Only the bands that hold the requested rows are decoded (see mci_get_band_rows()), so for
+/// MCI_COMP_LZG_BANDS images the cost is proportional to the number of requested rows. Rows outside
+/// of the range may also be written (the rest of the bands, and for images that are a single band,
+/// any rows of the image), so the pixel buffer must be able to hold the entire image.
+/// @param mci_data The MCI data buffer.
+/// @param[out] pixels The target pixel buffer (mci_get_pixels_size() bytes). The rows are written
+/// to the same position as by mci_decode_pixels().
+/// @param first_row The first row to decode.
+/// @param num_rows The number of rows to decode.
+void mci_decode_rows(const uint8_t* mci_data,
+                     uint32_t* pixels,
+                     uint32_t first_row,
+                     uint32_t num_rows);
+
+/// @brief Get the buffer size that is required for decoding the pixel data in place.
+///
+/// An MCI_COMP_LZG_INPLACE image can be decoded without a separate buffer for the compressed data:
+/// The compressed data is loaded at the end of the pixel buffer (at mci_get_inplace_offset()), and
+/// is then decoded with mci_decode_pixels_inplace(). The pixel buffer must be slightly larger than
+/// the decoded pixel data, so that the decoder never overwrites compressed data that it has not
+/// read yet.
+///
+/// Only the header, the palette and the first four bytes of the pixel data need to be present in
+/// the MCI buffer.
+/// @param mci_data The MCI data buffer.
+/// @returns the size of the pixel buffer (mci_get_pixels_size() for other compression methods).
+uint32_t mci_get_inplace_size(const uint8_t* mci_data);
+
+/// @brief Get the offset in the pixel buffer at which the compressed data should be loaded.
+///
+/// The compressed data is the pixel data of the MCI image, excluding its first four bytes (i.e.
+/// the last pixel_data_size - 4 bytes of the MCI data).
+/// @param mci_data The MCI data buffer (see mci_get_inplace_size()).
+/// @returns the offset (in bytes), or zero if the image is not an MCI_COMP_LZG_INPLACE image.
+uint32_t mci_get_inplace_offset(const uint8_t* mci_data);
+
+/// @brief Decode pixel data in place.
+/// @param mci_data The MCI data buffer (see mci_get_inplace_size()).
+/// @param[in,out] pixels The pixel buffer (mci_get_inplace_size() bytes), with the compressed
+/// data loaded at mci_get_inplace_offset().
+void mci_decode_pixels_inplace(const uint8_t* mci_data, uint32_t* pixels);
+
+/// @brief Decode an MCI image (or a part of it) into a framebuffer.
+///
+/// The image pixel (x, y) is written to (dst_x + x - src_rect->x0, dst_y + y - src_rect->y0) in
+/// the framebuffer, honoring the clip rectangle of the framebuffer (but not its blend mode). Only
+/// the image rows that are needed are decoded. If the framebuffer has a palette, the image palette
+/// is loaded into it.
+///
+/// If the entire image is decoded to the full width of the framebuffer, the pixels are decoded
+/// directly into the framebuffer. Otherwise uncompressed images are copied directly from the MCI
+/// data, while compressed images are decoded to a temporary buffer on the heap (for
+/// MCI_COMP_LZG_BANDS images, only the bands that hold the visible rows are decoded).
+/// @param mci_data The MCI data buffer.
+/// @param fb The target framebuffer (must have the same color mode as the image pixel format).
+/// @param dst_x Destination x coordinate.
+/// @param dst_y Destination y coordinate.
+/// @param src_rect The part of the image to decode, or NULL to decode the entire image.
+/// @returns a non-zero value on success, or zero if the image could not be decoded.
+int mci_decode_to_fb(const uint8_t* mci_data,
+                     fb_t* fb,
+                     int dst_x,
+                     int dst_y,
+                     const fb_rect_t* src_rect);
+
 /// @brief Get a pointer to the raw pixels from an MCI buffer.
 /// @param mci_data The MCI data buffer.
 /// @returns the internal pixel buffer if the MCI data is valid, otherwise NULL.
 const uint32_t* mci_get_raw_pixels(const uint8_t* mci_data);
 
+/// @brief State of an incremental MCI decoder (see mci_stream_init()).
+typedef struct {
+  mci_header_t hdr;      ///< The image header.
+  uint8_t* pixels;       ///< Target pixel buffer.
+  uint8_t* palette;      ///< Target palette buffer (may be NULL).
+  uint32_t stride;       ///< Bytes per row.
+  uint32_t pixels_size;  ///< Size of the decoded pixel data.
+  uint32_t offset;       ///< Number of MCI data bytes that have been fed.
+  uint32_t copied;       ///< Number of pixel bytes that have been copied (MCI_COMP_NONE).
+  lzg_stream_t lzg;      ///< LZG decoder state (MCI_COMP_LZG*).
+} mci_stream_t;
+
+/// @brief Start decoding an MCI image incrementally.
+///
+/// The MCI data is fed in chunks of any size with mci_stream_feed(), and is decoded straight into
+/// the target buffers as it arrives. Neither the compressed image nor the complete MCI data needs
+/// to be in memory at once, so an image can be decoded into a visible framebuffer while it is being
+/// read from a file, for instance:
+///
+/// @code
+///   mci_stream_t stream;
+///   n = read(fd, buf, sizeof(buf));
+///   const mci_header_t* hdr = mci_get_header(buf);
+///   fb_t* fb = fb_create(hdr->width, hdr->height, hdr->pixel_format);
+///   mci_stream_init(&stream, hdr, fb->pixels, fb->palette);
+///   while (n > 0) {
+///     mci_stream_feed(&stream, buf, n);
+///     n = read(fd, buf, sizeof(buf));
+///   }
+/// @endcode
+/// @param stream The decoder state.
+/// @param hdr The MCI header (e.g. from mci_get_header() on the first chunk of the MCI data).
+/// @param[out] pixels The target pixel buffer (mci_get_pixels_size() bytes).
+/// @param[out] palette The target palette buffer, or NULL to skip the palette.
+/// @returns a non-zero value on success, or zero if the header is invalid or if the compression
+/// method is not supported (MCI_COMP_LZG_BANDS images can not be decoded incrementally).
+int mci_stream_init(mci_stream_t* stream,
+                    const mci_header_t* hdr,
+                    uint32_t* pixels,
+                    uint32_t* palette);
+
+/// @brief Decode the next chunk of MCI data.
+///
+/// The MCI data is fed from the start (including the header).
+/// @param stream The decoder state.
+/// @param data The next chunk of MCI data.
+/// @param size The size of the chunk (in bytes).
+/// @returns the number of bytes that were used, which is less than @c size only if the chunk
+/// extends past the end of the MCI data.
+uint32_t mci_stream_feed(mci_stream_t* stream, const uint8_t* data, uint32_t size);
+
+/// @brief Get the number of image rows that have been fully decoded.
+///
+/// Decoded rows are never modified by later calls to mci_stream_feed(), so they can be shown (or
+/// processed) while the rest of the image is being decoded.
+/// @param stream The decoder state.
+/// @returns the number of complete rows (the image height when the image has been decoded).
+uint32_t mci_stream_rows_ready(const mci_stream_t* stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,92 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2020 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_SDF_FONT_H_
+#define MC1_SDF_FONT_H_
+
+#include <mc1/framebuffer.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief A signed distance field (SDF) font.
+///
+/// The font is an atlas of the built in vector font glyphs (characters 32 to 127), as generated by
+/// the sdffont tool. Each atlas pixel holds the distance to the closest glyph edge, so text can be
+/// drawn at any size by sampling the atlas (with bilinear filtering) and mapping the distance to a
+/// pixel coverage, without rasterizing the glyphs again.
+typedef struct {
+  const uint8_t* pixels;  ///< Atlas pixels (one distance value per byte).
+  uint32_t stride;        ///< Atlas row stride (in bytes).
+  int cell_size;          ///< Width and height of a glyph cell in the atlas (in pixels).
+  int owns_pixels;        ///< Non-zero if the pixels were allocated by sdf_font_init().
+} sdf_font_t;
+
+/// @brief Initialize an SDF font from an MCI atlas.
+///
+/// An uncompressed atlas is used in place (the MCI data must remain valid until the font is freed),
+/// while a compressed atlas is decoded to a buffer that is allocated on the heap.
+/// @param font The font object.
+/// @param mci_data The MCI data buffer (as generated by sdffont).
+/// @returns a non-zero value on success, or zero if the MCI data is not a valid SDF atlas or if the
+/// atlas could not be allocated.
+int sdf_font_init(sdf_font_t* font, const uint8_t* mci_data);
+
+/// @brief Free memory that was allocated by sdf_font_init().
+/// @param font The font object.
+void sdf_font_deinit(sdf_font_t* font);
+
+/// @brief Get the width of a text string.
+/// @param font The font object.
+/// @param size The text size (height of a glyph cell, in pixels).
+/// @param text The zero terminated text string.
+/// @returns the advance width (in pixels) of the longest line of the text.
+int sdf_font_text_width(const sdf_font_t* font, int size, const char* text);
+
+/// @brief Draw a text string.
+///
+/// The glyphs are anti-aliased. In RGBA8888 mode the glyph coverage (multiplied by the alpha of
+/// the color) is blended over the destination pixels, and in the other color modes pixels that are
+/// at least half covered are set to the color. The clip rectangle of the framebuffer is honored,
+/// but its blend mode is not used. A newline character moves to the start of the next line (size
+/// pixels down, at the original x coordinate).
+/// @param fb The framebuffer object.
+/// @param font The font object.
+/// @param x Text origin x coordinate (left edge of the first glyph cell).
+/// @param y Text origin y coordinate (top edge of the first glyph cell).
+/// @param size The text size (height of a glyph cell, in pixels).
+/// @param text The zero terminated text string.
+/// @param color The text color.
+void sdf_font_draw_text(fb_t* fb,
+                        const sdf_font_t* font,
+                        int x,
+                        int y,
+                        int size,
+                        const char* text,
+                        uint32_t color);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_SDF_FONT_H_
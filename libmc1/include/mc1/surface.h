@@ -0,0 +1,326 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2020 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_SURFACE_H_
+#define MC1_SURFACE_H_
+
+#include <mc1/framebuffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef __MRISC32__
+#include <mr32intrin.h>
+#endif
+
+namespace mc1 {
+
+/// @brief Get the base 2 logarithm of the number of pixels per word for a color mode.
+constexpr uint32_t cmode_log2ppw(const int cmode) {
+  return cmode == CMODE_RGBA8888   ? 0
+         : cmode == CMODE_RGBA5551 ? 1
+         : cmode == CMODE_PAL8     ? 2
+         : cmode == CMODE_PAL4     ? 3
+         : cmode == CMODE_PAL2     ? 4
+                                   : 5;
+}
+
+namespace surface_detail {
+
+inline uint32_t repeat2x16(const uint32_t x) {
+#ifdef __MRISC32__
+  return _mr32_shuf(x, _MR32_SHUFCTL(0, 1, 0, 1, 0));
+#else
+  return (x << 16) | (x & 0xffff);
+#endif
+}
+
+inline uint32_t repeat4x8(const uint32_t x) {
+#ifdef __MRISC32__
+  return _mr32_shuf(x, _MR32_SHUFCTL(0, 0, 0, 0, 0));
+#else
+  return repeat2x16((x << 8) | (x & 255));
+#endif
+}
+
+inline uint32_t repeat8x4(const uint32_t x) {
+#ifdef __MRISC32_PACKED_OPS__
+  return repeat4x8(_mr32_pack_b(x, x));
+#else
+  return repeat4x8((x << 4) | (x & 15));
+#endif
+}
+
+inline uint32_t repeat16x2(const uint32_t x) {
+  return repeat8x4((x << 2) | (x & 3));
+}
+
+inline uint32_t repeat32x1(const uint32_t x) {
+  return static_cast<uint32_t>(-static_cast<int32_t>(x & 1));
+}
+
+/// @brief Select bits from a or b.
+/// @returns (a & mask) | (b & ~mask)
+inline uint32_t bitmix(const uint32_t mask, const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32__
+  uint32_t result = a;
+  __asm volatile("sel.213 %[result],%[mask],%[b]"
+                 : [ result ] "+r"(result)
+                 : [ mask ] "r"(mask), [ b ] "r"(b));
+  return result;
+#else
+  return (a & mask) | (b & ~mask);
+#endif
+}
+
+/// @brief Multiply all four bytes of a by the byte value b (0-255).
+/// @returns (a * b) >> 8, for each byte of a.
+inline uint32_t scale_u8x4(const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32_PACKED_OPS__
+  return _mr32_mulhiu_b(a, repeat4x8(b));
+#else
+  const uint32_t lo = (((a & 0x00ff00ffU) * b) >> 8) & 0x00ff00ffU;
+  const uint32_t hi = (((a >> 8) & 0x00ff00ffU) * b) & 0xff00ff00U;
+  return lo | hi;
+#endif
+}
+
+}  // namespace surface_detail
+
+/// @brief A view of a pixel buffer with a color mode that is known at compile time.
+///
+/// All pixel access is resolved at compile time to direct loads and stores (for 8, 16 and 32 bpp)
+/// or word shifts and masks (for 1, 2 and 4 bpp). No clipping is done: all coordinates must be
+/// inside the surface.
+///
+/// Example:
+/// @code
+///   mc1::surface_t<CMODE_PAL8> s(fb);
+///   for (int y = 0; y < s.height(); ++y) {
+///     auto it = s.row(y);
+///     for (int x = 0; x < s.width(); ++x, ++it) {
+///       it.put(x ^ y);
+///     }
+///   }
+/// @endcode
+template <int CMODE>
+class surface_t {
+public:
+  static constexpr uint32_t LOG2PPW = cmode_log2ppw(CMODE);  ///< log2(pixels per word)
+  static constexpr uint32_t PPW = 1U << LOG2PPW;             ///< Pixels per word
+  static constexpr uint32_t BPP = 32U >> LOG2PPW;            ///< Bits per pixel
+  static constexpr uint32_t PIXEL_MASK = 0xffffffffU >> (32U - BPP);
+
+  /// @brief The storage type of a single pixel (only used for 8, 16 and 32 bpp).
+  using pixel_t = typename std::conditional<
+      (LOG2PPW == 0),
+      uint32_t,
+      typename std::conditional<(LOG2PPW == 1), uint16_t, uint8_t>::type>::type;
+
+  /// @brief Iterator over the pixels of a row (left to right).
+  class row_iterator_t {
+  public:
+    row_iterator_t(void* row, const int x) {
+      if constexpr (LOG2PPW <= 2) {
+        m_ptr = &static_cast<pixel_t*>(row)[x];
+      } else {
+        m_ptr = &static_cast<uint32_t*>(row)[x >> LOG2PPW];
+        m_shift = (static_cast<uint32_t>(x) & (PPW - 1)) * BPP;
+      }
+    }
+
+    uint32_t get() const {
+      if constexpr (LOG2PPW <= 2) {
+        return *m_ptr;
+      } else {
+        return (*m_ptr >> m_shift) & PIXEL_MASK;
+      }
+    }
+
+    void put(const uint32_t color) const {
+      if constexpr (LOG2PPW <= 2) {
+        *m_ptr = static_cast<pixel_t>(color);
+      } else {
+        *m_ptr = surface_detail::bitmix(PIXEL_MASK << m_shift, color << m_shift, *m_ptr);
+      }
+    }
+
+    row_iterator_t& operator++() {
+      if constexpr (LOG2PPW <= 2) {
+        ++m_ptr;
+      } else {
+        m_shift += BPP;
+        if (m_shift == 32U) {
+          m_shift = 0U;
+          ++m_ptr;
+        }
+      }
+      return *this;
+    }
+
+  private:
+    using ptr_t = typename std::conditional<(LOG2PPW <= 2), pixel_t*, uint32_t*>::type;
+    ptr_t m_ptr;
+    uint32_t m_shift = 0U;
+  };
+
+  explicit surface_t(fb_t* fb)
+      : m_pixels(static_cast<uint8_t*>(fb->pixels)),
+        m_stride(fb->stride),
+        m_width(fb->width),
+        m_height(fb->height) {
+  }
+
+  surface_t(void* pixels, const size_t stride, const int width, const int height)
+      : m_pixels(static_cast<uint8_t*>(pixels)),
+        m_stride(stride),
+        m_width(width),
+        m_height(height) {
+  }
+
+  int width() const {
+    return m_width;
+  }
+
+  int height() const {
+    return m_height;
+  }
+
+  size_t stride() const {
+    return m_stride;
+  }
+
+  /// @brief Get a pointer to the first pixel of a row.
+  void* row_ptr(const int y) const {
+    return &m_pixels[static_cast<ptrdiff_t>(y) * static_cast<ptrdiff_t>(m_stride)];
+  }
+
+  /// @brief Get an iterator for a row, starting at pixel x.
+  row_iterator_t row(const int y, const int x = 0) const {
+    return row_iterator_t(row_ptr(y), x);
+  }
+
+  /// @brief Get the color of a pixel.
+  uint32_t get(const int x, const int y) const {
+    return get(row_ptr(y), x);
+  }
+
+  /// @brief Set the color of a pixel.
+  void put(const int x, const int y, const uint32_t color) const {
+    put(row_ptr(y), x, color);
+  }
+
+  /// @brief Fill a horizontal span of n pixels, starting at (x, y).
+  void hspan(const int x, const int y, const int n, const uint32_t color) const {
+    hspan(row_ptr(y), x, n, color);
+  }
+
+  /// @brief Get the color of pixel x of a row.
+  static uint32_t get(const void* row, const int x) {
+    if constexpr (LOG2PPW <= 2) {
+      return static_cast<const pixel_t*>(row)[x];
+    } else {
+      const auto word = static_cast<const uint32_t*>(row)[x >> LOG2PPW];
+      const auto shift = (static_cast<uint32_t>(x) & (PPW - 1)) * BPP;
+      return (word >> shift) & PIXEL_MASK;
+    }
+  }
+
+  /// @brief Set the color of pixel x of a row.
+  static void put(void* row, const int x, const uint32_t color) {
+    if constexpr (LOG2PPW <= 2) {
+      static_cast<pixel_t*>(row)[x] = static_cast<pixel_t>(color);
+    } else {
+      auto* ptr = &static_cast<uint32_t*>(row)[x >> LOG2PPW];
+      const auto shift = (static_cast<uint32_t>(x) & (PPW - 1)) * BPP;
+      *ptr = surface_detail::bitmix(PIXEL_MASK << shift, color << shift, *ptr);
+    }
+  }
+
+  /// @brief Fill n pixels of a row, starting at pixel x.
+  static void hspan(void* row, const int x, const int n, const uint32_t color) {
+    if (n <= 0) {
+      return;
+    }
+    if constexpr (LOG2PPW <= 2) {
+      auto* ptr = &static_cast<pixel_t*>(row)[x];
+      const auto c = static_cast<pixel_t>(color);
+      for (int k = 0; k < n; ++k) {
+        ptr[k] = c;
+      }
+    } else {
+      // Whole words are written directly, and partial words at the ends are masked.
+      const auto word_color = repeat(color);
+      auto* ptr = &static_cast<uint32_t*>(row)[x >> LOG2PPW];
+      const auto first = static_cast<uint32_t>(x) & (PPW - 1);
+      const auto end = first + static_cast<uint32_t>(n);
+      if (end <= PPW) {
+        const auto mask = low_bits(end) & ~low_bits(first);
+        *ptr = surface_detail::bitmix(mask, word_color, *ptr);
+        return;
+      }
+      if (first != 0U) {
+        *ptr = surface_detail::bitmix(~low_bits(first), word_color, *ptr);
+        ++ptr;
+      }
+      auto* const last = &ptr[(end >> LOG2PPW) - (first != 0U ? 1U : 0U)];
+      while (ptr < last) {
+        *ptr++ = word_color;
+      }
+      const auto tail = end & (PPW - 1);
+      if (tail != 0U) {
+        *ptr = surface_detail::bitmix(low_bits(tail), word_color, *ptr);
+      }
+    }
+  }
+
+  /// @brief Repeat a pixel color to fill an entire word.
+  static uint32_t repeat(const uint32_t color) {
+    if constexpr (LOG2PPW == 0) {
+      return color;
+    } else if constexpr (LOG2PPW == 1) {
+      return surface_detail::repeat2x16(color);
+    } else if constexpr (LOG2PPW == 2) {
+      return surface_detail::repeat4x8(color);
+    } else if constexpr (LOG2PPW == 3) {
+      return surface_detail::repeat8x4(color);
+    } else if constexpr (LOG2PPW == 4) {
+      return surface_detail::repeat16x2(color);
+    } else {
+      return surface_detail::repeat32x1(color);
+    }
+  }
+
+private:
+  // A mask for the bits of the first k pixels of a word (0 <= k <= PPW).
+  static constexpr uint32_t low_bits(const uint32_t k) {
+    return (k < PPW) ? ((1U << (k * BPP)) - 1U) : 0xffffffffU;
+  }
+
+  uint8_t* m_pixels;
+  size_t m_stride;
+  int m_width;
+  int m_height;
+};
+
+}  // namespace mc1
+
+#endif  // MC1_SURFACE_H_
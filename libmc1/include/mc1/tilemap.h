@@ -0,0 +1,139 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_TILEMAP_H_
+#define MC1_TILEMAP_H_
+
+#include <mc1/framebuffer.h>
+#include <mc1/vcp.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Scrolling tile maps.
+//
+// A tile map is rendered into a ring buffer in VRAM that is slightly larger than the view (one
+// extra tile column and one extra tile row). World pixel (x, y) is stored at word offset
+// (y * stride + x / pixels_per_word) modulo the ring size, so that scrolling in any direction is
+// done by changing the per-row VCP addresses and the XOFFS register, and only the tiles that are
+// scrolled into view (or that have been changed) need to be drawn.
+//
+// The tile map wraps around, i.e. the tile at map position (col, row) is repeated at
+// (col + k * map_width, row + l * map_height).
+//--------------------------------------------------------------------------------------------------
+
+/// @brief Flag that is set in the tile map for tiles that have been changed but not yet drawn.
+#define TILEMAP_DIRTY 0x8000u
+
+typedef struct {
+  // Tile set.
+  const fb_t* tiles;  ///< Tile set (tiles are arranged in a grid).
+  int tile_w;         ///< Tile width (a multiple of the number of pixels per word).
+  int tile_h;         ///< Tile height.
+  int tiles_per_row;  ///< Number of tiles per row in the tile set.
+
+  // Tile map.
+  uint16_t* map;  ///< Tile indices (map_w * map_h entries, row-major).
+  int map_w;      ///< Map width (in tiles).
+  int map_h;      ///< Map height (in tiles).
+
+  // Ring buffer and VCP.
+  uint32_t* vcp;       ///< The VCP program.
+  uint32_t* palette;   ///< Palette (or NULL for non-palette color modes).
+  uint32_t* ring;      ///< Ring buffer pixels (followed by a guard area of ring_stride words).
+  size_t ring_stride;  ///< Number of words per ring buffer row.
+  size_t ring_size;    ///< Number of words in the ring buffer (excluding the guard area).
+  int view_w;          ///< View width (in pixels).
+  int view_h;          ///< View height (in pixels).
+  int mode;            ///< Color mode.
+
+  // Render state.
+  uint32_t* vcp_rows;  ///< Points to the XOFFS instruction, followed by the row ADDR instructions.
+  int res_col;         ///< First resident tile column.
+  int res_row;         ///< First resident tile row.
+  int res_cols;        ///< Number of resident tile columns.
+  int res_rows;        ///< Number of resident tile rows.
+  int valid;           ///< Non-zero if the resident tiles have been drawn.
+  int any_dirty;       ///< Non-zero if any tile has been changed since the last render.
+} tilemap_t;
+
+/// @brief Create a new tile map.
+/// @param view_w The width of the view (in pixels).
+/// @param view_h The height of the view (in pixels).
+/// @param tiles The tile set. Its color mode is used for the tile map, and it must be kept alive
+/// for the lifetime of the tile map. It can reside in VRAM or in XRAM (see fb_create_offscreen()).
+/// @param tile_w Tile width (must be a multiple of the number of pixels per word).
+/// @param tile_h Tile height.
+/// @param map_w The width of the map (in tiles).
+/// @param map_h The height of the map (in tiles).
+/// @returns a tile map object (with all tile indices set to zero), or NULL if the tile map could
+/// not be created.
+tilemap_t* tilemap_create(int view_w,
+                          int view_h,
+                          const fb_t* tiles,
+                          int tile_w,
+                          int tile_h,
+                          int map_w,
+                          int map_h);
+
+/// @brief Free a tile map and associated memory.
+/// @param tm The tile map object.
+void tilemap_destroy(tilemap_t* tm);
+
+/// @brief Show the tile map (i.e. make it current).
+/// @param tm The tile map object.
+/// @param layer The layer to use for the tile map (1 or 2).
+void tilemap_show(tilemap_t* tm, layer_t layer);
+
+/// @brief Set a tile in the tile map.
+///
+/// The tile is drawn by the next call to tilemap_render() if it is in view and if the tile index
+/// changed. A tile index that is outside of the tile set is drawn as an all zero tile.
+/// @param tm The tile map object.
+/// @param col The tile column.
+/// @param row The tile row.
+/// @param index The tile index (0-32767).
+void tilemap_set_tile(tilemap_t* tm, int col, int row, unsigned index);
+
+/// @brief Get a tile from the tile map.
+/// @param tm The tile map object.
+/// @param col The tile column.
+/// @param row The tile row.
+/// @returns the tile index.
+unsigned tilemap_get_tile(const tilemap_t* tm, int col, int row);
+
+/// @brief Scroll the view and draw all tiles that have been scrolled into view or changed.
+///
+/// To avoid tearing, this should be called during the vertical blanking interval.
+/// @param tm The tile map object.
+/// @param x The x coordinate of the upper left corner of the view (in pixels).
+/// @param y The y coordinate of the upper left corner of the view (in pixels).
+void tilemap_render(tilemap_t* tm, int x, int y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_TILEMAP_H_
@@ -0,0 +1,115 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2022 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MC1_TRANSFORM_H_
+#define MC1_TRANSFORM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Batched point transformations.
+//
+// All points are given in structure-of-arrays form, i.e. as separate x, y and z arrays. Matrices
+// are stored in row-major order, and points are treated as column vectors with an implicit
+// w = 1.0, so that for a 3x4 matrix:
+//
+//   x' = m[0] * x + m[1] * y + m[2]  * z + m[3]
+//   y' = m[4] * x + m[5] * y + m[6]  * z + m[7]
+//   z' = m[8] * x + m[9] * y + m[10] * z + m[11]
+//
+// A 4x4 matrix adds a fourth row (m[12]..m[15]) that produces the homogeneous w coordinate.
+//
+// Input and output arrays may be the same (in-place transformation), but must not otherwise
+// overlap.
+//--------------------------------------------------------------------------------------------------
+
+// Clip code bits (see clip_codes()).
+#define CLIP_LEFT   0x01  ///< x < -w
+#define CLIP_RIGHT  0x02  ///< x > w
+#define CLIP_BOTTOM 0x04  ///< y < -w
+#define CLIP_TOP    0x08  ///< y > w
+#define CLIP_NEAR   0x10  ///< z < -w
+#define CLIP_FAR    0x20  ///< z > w
+
+/// @brief Transform points by an affine 3x4 matrix.
+/// @param m The 3x4 matrix (12 floats, row-major).
+/// @param x Source x coordinates.
+/// @param y Source y coordinates.
+/// @param z Source z coordinates.
+/// @param[out] out_x Transformed x coordinates.
+/// @param[out] out_y Transformed y coordinates.
+/// @param[out] out_z Transformed z coordinates.
+/// @param count Number of points.
+void transform_points(const float* m,
+                      const float* x,
+                      const float* y,
+                      const float* z,
+                      float* out_x,
+                      float* out_y,
+                      float* out_z,
+                      int count);
+
+/// @brief Transform points by a 4x4 matrix and do the perspective division.
+///
+/// The third row of the matrix (m[8]..m[11]) is not used, since the depth is returned as 1/w.
+/// @param m The 4x4 projection matrix (16 floats, row-major).
+/// @param x Source x coordinates.
+/// @param y Source y coordinates.
+/// @param z Source z coordinates.
+/// @param[out] out_x Projected x coordinates (x / w).
+/// @param[out] out_y Projected y coordinates (y / w).
+/// @param[out] out_inv_w The reciprocal of the homogeneous w coordinate (1 / w).
+/// @param count Number of points.
+/// @note Points with w = 0 give undefined results. Use clip_codes() to find such points.
+void project_points(const float* m,
+                    const float* x,
+                    const float* y,
+                    const float* z,
+                    float* out_x,
+                    float* out_y,
+                    float* out_inv_w,
+                    int count);
+
+/// @brief Calculate clip codes for points.
+///
+/// Each point is transformed to clip space by the 4x4 matrix, and the resulting code is a
+/// combination of the CLIP_* bits, telling which clip planes the point is outside of.
+/// @param m The 4x4 projection matrix (16 floats, row-major).
+/// @param x Source x coordinates.
+/// @param y Source y coordinates.
+/// @param z Source z coordinates.
+/// @param[out] codes The clip codes (one byte per point).
+/// @param count Number of points.
+void clip_codes(const float* m,
+                const float* x,
+                const float* y,
+                const float* z,
+                uint8_t* codes,
+                int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MC1_TRANSFORM_H_
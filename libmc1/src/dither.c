@@ -0,0 +1,248 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2020 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <mc1/dither.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __MRISC32__
+#include <mr32intrin.h>
+#endif
+
+// 4x4 Bayer matrix.
+static const uint8_t s_bayer[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5},
+};
+
+// Replicate an 8-bit value to the R, G and B channels of a pixel.
+static inline uint32_t rgb_splat(const uint32_t x) {
+  return x * 0x00010101U;
+}
+
+// Unsigned saturating add of four bytes.
+static inline uint32_t add_sat_u8x4(const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32_PACKED_OPS__
+  return _mr32_addsu_b(a, b);
+#else
+  const uint32_t s = ((a & 0x7f7f7f7fU) + (b & 0x7f7f7f7fU)) ^ ((a ^ b) & 0x80808080U);
+  const uint32_t carry = ((a & b) | ((a | b) & ~s)) & 0x80808080U;
+  return s | ((carry >> 7) * 0xffU);
+#endif
+}
+
+// Unsigned saturating subtract of four bytes.
+static inline uint32_t sub_sat_u8x4(const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32_PACKED_OPS__
+  return _mr32_subsu_b(a, b);
+#else
+  const uint32_t d = ((a | 0x80808080U) - (b & 0x7f7f7f7fU)) ^ ((a ^ ~b) & 0x80808080U);
+  const uint32_t borrow = ((~a & b) | (~(a ^ b) & d)) & 0x80808080U;
+  return d & ~((borrow >> 7) * 0xffU);
+#endif
+}
+
+// Convert an RGBA8888 pixel to RGBA5551 (by truncation).
+static inline uint32_t to_rgba5551(const uint32_t c) {
+  return ((c >> 3) & 0x001fU) | ((c >> 6) & 0x03e0U) | ((c >> 9) & 0x7c00U) |
+         ((c >> 16) & 0x8000U);
+}
+
+// Get the dither offsets for four consecutive pixels, starting at (x, y). The offsets are in the
+// range [0, 2^shift).
+static void get_offsets(uint32_t* offsets, const int x, const int y, const int shift) {
+  const uint8_t* bayer_row = &s_bayer[y & 3][0];
+  for (int k = 0; k < 4; ++k) {
+    offsets[k] = rgb_splat(((uint32_t)bayer_row[(x + k) & 3] << shift) >> 4);
+  }
+}
+
+// Get zero centered dither offsets for four consecutive pixels, starting at (x, y). The offsets
+// are in the range [-2^(shift-1), 2^(shift-1)), and are split into a positive and a negative part
+// (one of which is zero) so that they can be applied with saturating byte operations.
+static void get_centered_offsets(uint32_t* pos_offsets,
+                                 uint32_t* neg_offsets,
+                                 const int x,
+                                 const int y,
+                                 const int shift) {
+  const uint8_t* bayer_row = &s_bayer[y & 3][0];
+  const int bias = (1 << shift) >> 1;
+  for (int k = 0; k < 4; ++k) {
+    const int d = (((int)bayer_row[(x + k) & 3] << shift) >> 4) - bias;
+    pos_offsets[k] = rgb_splat((uint32_t)(d > 0 ? d : 0));
+    neg_offsets[k] = rgb_splat((uint32_t)(d < 0 ? -d : 0));
+  }
+}
+
+void dither_init_ipal(dither_ipal_t* ipal, const uint32_t* palette, int num_colors) {
+  // Unpack the palette colors.
+  int pal_r[256];
+  int pal_g[256];
+  int pal_b[256];
+  if (num_colors > 256) {
+    num_colors = 256;
+  }
+  for (int i = 0; i < num_colors; ++i) {
+    pal_r[i] = (int)(palette[i] & 255U);
+    pal_g[i] = (int)((palette[i] >> 8) & 255U);
+    pal_b[i] = (int)((palette[i] >> 16) & 255U);
+  }
+
+  // Find the closest palette color for the center of each cell in the cube.
+  const int CELL_SIZE = 256 >> DITHER_IPAL_BITS;
+  uint8_t* index = &ipal->index[0];
+  for (int b = CELL_SIZE / 2; b < 256; b += CELL_SIZE) {
+    for (int g = CELL_SIZE / 2; g < 256; g += CELL_SIZE) {
+      for (int r = CELL_SIZE / 2; r < 256; r += CELL_SIZE) {
+        int best_idx = 0;
+        int best_dist = 0x7fffffff;
+        for (int i = 0; i < num_colors; ++i) {
+          const int dr = r - pal_r[i];
+          const int dg = g - pal_g[i];
+          const int db = b - pal_b[i];
+          const int dist = dr * dr + dg * dg + db * db;
+          if (dist < best_dist) {
+            best_dist = dist;
+            best_idx = i;
+          }
+        }
+        *index++ = (uint8_t)best_idx;
+      }
+    }
+  }
+
+  // Select a dither amplitude (a power of two) that is close to the average distance (the largest
+  // per-component difference) between each palette color and its closest neighbour.
+  int dist_sum = 0;
+  int dist_count = 0;
+  for (int i = 0; i < num_colors; ++i) {
+    int min_dist = 256;
+    for (int j = 0; j < num_colors; ++j) {
+      const int dr = abs(pal_r[i] - pal_r[j]);
+      const int dg = abs(pal_g[i] - pal_g[j]);
+      const int db = abs(pal_b[i] - pal_b[j]);
+      int dist = dr > dg ? dr : dg;
+      dist = db > dist ? db : dist;
+      if (dist > 0 && dist < min_dist) {
+        min_dist = dist;
+      }
+    }
+    dist_sum += min_dist;
+    ++dist_count;
+  }
+  const int avg_dist = dist_count > 0 ? dist_sum / dist_count : 256;
+  int shift = 3;
+  while (shift < 8 && (3 << shift) <= 2 * avg_dist) {
+    ++shift;
+  }
+  ipal->dither_shift = shift;
+}
+
+void dither_row_rgba5551(uint16_t* dst, const uint32_t* src, int count, int x, int y) {
+  uint32_t offsets[4];
+  get_offsets(offsets, x, y, 8 - 5);
+  for (int i = 0; i < count; ++i) {
+    dst[i] = (uint16_t)to_rgba5551(add_sat_u8x4(src[i], offsets[i & 3]));
+  }
+}
+
+void dither_row_pal8(uint8_t* dst,
+                     const uint32_t* src,
+                     int count,
+                     int x,
+                     int y,
+                     const dither_ipal_t* ipal) {
+  // Note: The inverse palette lookup finds the closest color (rather than truncating), so the
+  // dither offsets need to be centered around zero.
+  uint32_t pos_offsets[4];
+  uint32_t neg_offsets[4];
+  get_centered_offsets(pos_offsets, neg_offsets, x, y, ipal->dither_shift);
+  const uint8_t* index = &ipal->index[0];
+  for (int i = 0; i < count; ++i) {
+    const uint32_t c = sub_sat_u8x4(add_sat_u8x4(src[i], pos_offsets[i & 3]), neg_offsets[i & 3]);
+    dst[i] = index[to_rgba5551(c) & 0x7fffU];
+  }
+}
+
+void dither_to_fb(fb_t* fb,
+                  int x,
+                  int y,
+                  const uint32_t* src,
+                  size_t src_stride,
+                  int w,
+                  int h,
+                  const dither_ipal_t* ipal) {
+  // Clip the rectangle.
+  const fb_rect_t* clip = &fb->clip;
+  int x0 = x > clip->x0 ? x : clip->x0;
+  int y0 = y > clip->y0 ? y : clip->y0;
+  int x1 = (x + w) < clip->x1 ? (x + w) : clip->x1;
+  int y1 = (y + h) < clip->y1 ? (y + h) : clip->y1;
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+  if (fb->mode >= CMODE_PAL8 && ipal == NULL) {
+    return;
+  }
+  const int count = x1 - x0;
+
+  const uint8_t* src_row = (const uint8_t*)src + (size_t)(y0 - y) * src_stride;
+  uint8_t* dst_row = (uint8_t*)fb->pixels + (size_t)y0 * fb->stride;
+  for (int yy = y0; yy < y1; ++yy) {
+    const uint32_t* s = &((const uint32_t*)src_row)[x0 - x];
+    switch (fb->mode) {
+      case CMODE_RGBA8888:
+        memcpy(&((uint32_t*)dst_row)[x0], s, (size_t)count * 4U);
+        break;
+      case CMODE_RGBA5551:
+        dither_row_rgba5551(&((uint16_t*)dst_row)[x0], s, count, x0, yy);
+        break;
+      case CMODE_PAL8:
+        dither_row_pal8(&dst_row[x0], s, count, x0, yy, ipal);
+        break;
+      default: {
+        // Sub-byte pixels: Convert a chunk of pixels to bytes, and pack them into words.
+        const int log2ppw = fb->mode;
+        const int bpp = 32 >> log2ppw;
+        const uint32_t pixel_mask = (1U << bpp) - 1U;
+        uint32_t* dst_words = (uint32_t*)dst_row;
+        uint8_t tmp[64];
+        for (int k = 0; k < count; k += (int)sizeof(tmp)) {
+          const int n = (count - k) < (int)sizeof(tmp) ? (count - k) : (int)sizeof(tmp);
+          dither_row_pal8(tmp, &s[k], n, x0 + k, yy, ipal);
+          for (int i = 0; i < n; ++i) {
+            const int xx = x0 + k + i;
+            const uint32_t shift = (uint32_t)(xx & ((1 << log2ppw) - 1)) * (uint32_t)bpp;
+            uint32_t* word = &dst_words[xx >> log2ppw];
+            *word = (*word & ~(pixel_mask << shift)) | (((uint32_t)tmp[i] & pixel_mask) << shift);
+          }
+        }
+        break;
+      }
+    }
+    src_row += src_stride;
+    dst_row += fb->stride;
+  }
+
+  fb_add_dirty(fb, x0, y0, count, y1 - y0);
+}
@@ -20,10 +20,12 @@
 
 #include <mc1/framebuffer.h>
 
+#include <mc1/gfx.h>
 #include <mc1/memory.h>
 #include <mc1/mmio.h>
 #include <mc1/vcp.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 //--------------------------------------------------------------------------------------------------
@@ -119,6 +121,7 @@ fb_t* fb_create(int width, int height, int mode) {
   fb->width = width;
   fb->height = height;
   fb->mode = mode;
+  fb_reset_clip(fb);
 
   // Get the native width and height of the video signal.
   const uint32_t native_width = MMIO(VIDWIDTH);
@@ -159,13 +162,132 @@ fb_t* fb_create(int width, int height, int mode) {
   return fb;
 }
 
+fb_t* fb_create_offscreen(int width, int height, int mode) {
+  // Sanity check input parameters.
+  size_t bpp = bits_per_pixel(mode);
+  if (width < 1 || height < 1 || bpp < 1) {
+    return NULL;
+  }
+
+  // Allocate memory for the framebuffer (no VCP or palette).
+  const size_t pix_size = calc_pixels_size(width, height, mode);
+  const size_t total_size = sizeof(fb_t) + pix_size;
+  fb_t* fb = (fb_t*)malloc(total_size);
+  if (!fb) {
+    return NULL;
+  }
+  memset(fb, 0, total_size);
+
+  // Populate the fb_t object fields.
+  fb->pixels = (void*)&((uint8_t*)fb)[sizeof(fb_t)];
+  fb->stride = calc_stride(width, mode);
+  fb->width = width;
+  fb->height = height;
+  fb->mode = mode;
+  fb_reset_clip(fb);
+
+  return fb;
+}
+
 void fb_destroy(fb_t* fb) {
-  vmem_free(fb);
+  // Offscreen framebuffers have no VCP.
+  if (fb != NULL && fb->vcp == NULL) {
+    free(fb);
+  } else {
+    vmem_free(fb);
+  }
 }
 
 void fb_show(fb_t* fb, layer_t layer) {
-  if (fb != NULL) {
+  if (fb != NULL && fb->vcp != NULL) {
     vcp_set_prg(layer, fb->vcp);
   }
 }
 
+void fb_reset_clip(fb_t* fb) {
+  fb->clip.x0 = 0;
+  fb->clip.y0 = 0;
+  fb->clip.x1 = fb->width;
+  fb->clip.y1 = fb->height;
+  fb->clip_depth = 0;
+}
+
+int fb_push_clip(fb_t* fb, int x, int y, int w, int h) {
+  if (fb->clip_depth >= FB_CLIP_STACK_SIZE) {
+    return 0;
+  }
+  fb->clip_stack[fb->clip_depth++] = fb->clip;
+  fb_intersect_clip(fb, x, y, w, h);
+  return 1;
+}
+
+void fb_pop_clip(fb_t* fb) {
+  if (fb->clip_depth > 0) {
+    fb->clip = fb->clip_stack[--fb->clip_depth];
+  }
+}
+
+void fb_intersect_clip(fb_t* fb, int x, int y, int w, int h) {
+  fb_rect_t* clip = &fb->clip;
+  clip->x0 = x > clip->x0 ? x : clip->x0;
+  clip->y0 = y > clip->y0 ? y : clip->y0;
+  clip->x1 = (x + w) < clip->x1 ? (x + w) : clip->x1;
+  clip->y1 = (y + h) < clip->y1 ? (y + h) : clip->y1;
+
+  // Keep empty rectangles normalized.
+  if (clip->x1 < clip->x0) {
+    clip->x1 = clip->x0;
+  }
+  if (clip->y1 < clip->y0) {
+    clip->y1 = clip->y0;
+  }
+}
+
+void fb_add_dirty(fb_t* fb, int x, int y, int w, int h) {
+  // Clamp to the framebuffer limits.
+  int x0 = x > 0 ? x : 0;
+  int y0 = y > 0 ? y : 0;
+  int x1 = (x + w) < fb->width ? (x + w) : fb->width;
+  int y1 = (y + h) < fb->height ? (y + h) : fb->height;
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+
+  fb_rect_t* dirty = &fb->dirty;
+  if (dirty->x1 <= dirty->x0) {
+    dirty->x0 = x0;
+    dirty->y0 = y0;
+    dirty->x1 = x1;
+    dirty->y1 = y1;
+  } else {
+    dirty->x0 = x0 < dirty->x0 ? x0 : dirty->x0;
+    dirty->y0 = y0 < dirty->y0 ? y0 : dirty->y0;
+    dirty->x1 = x1 > dirty->x1 ? x1 : dirty->x1;
+    dirty->y1 = y1 > dirty->y1 ? y1 : dirty->y1;
+  }
+}
+
+void fb_clear_dirty(fb_t* fb) {
+  fb->dirty.x0 = 0;
+  fb->dirty.y0 = 0;
+  fb->dirty.x1 = 0;
+  fb->dirty.y1 = 0;
+}
+
+void fb_present(fb_t* src, const fb_rect_t* rect, fb_t* dst, int dx, int dy) {
+  fb_rect_t r;
+  if (rect != NULL) {
+    r = *rect;
+  } else {
+    r = src->dirty;
+    fb_clear_dirty(src);
+  }
+  if (r.x1 <= r.x0 || r.y1 <= r.y0) {
+    return;
+  }
+
+  const int blend = dst->blend;
+  dst->blend = GFX_BLEND_NONE;
+  gfx_blit(dst, dx + r.x0, dy + r.y0, src, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+  dst->blend = blend;
+}
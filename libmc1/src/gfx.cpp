@@ -20,57 +20,35 @@
 
 #include <mc1/gfx.h>
 
+#include <mc1/surface.h>
+
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <type_traits>
 
-#ifdef __MRISC32__
-#include <mr32intrin.h>
-#endif
+extern "C" uint8_t mc1_font_8x8[(128 - 32) * 8];
 
 namespace {
 
-inline uint32_t repeat2x16(const uint32_t x) {
-#ifdef __MRISC32__
-  return _mr32_shuf(x, _MR32_SHUFCTL(0, 1, 0, 1, 0));
-#else
-  return (x << 16) | (x & 0xffff);
-#endif
-}
-
-inline uint32_t repeat4x8(const uint32_t x) {
-#ifdef __MRISC32__
-  return _mr32_shuf(x, _MR32_SHUFCTL(0, 0, 0, 0, 0));
-#else
-  return repeat2x16((x << 8) | (x & 255));
-#endif
-}
-
-inline uint32_t repeat8x4(const uint32_t x) {
-#ifdef __MRISC32_PACKED_OPS__
-  return repeat4x8(_mr32_pack_b(x, x));
-#else
-  return repeat4x8((x << 4) | (x & 15));
-#endif
-}
-
-inline uint32_t repeat16x2(const uint32_t x) {
-  return repeat8x4((x << 2) | (x & 3));
-}
+using mc1::surface_detail::bitmix;
+using mc1::surface_detail::scale_u8x4;
 
-inline uint32_t repeat32x1(const uint32_t x) {
-  return (static_cast<int32_t>(x) << 31) >> 31;
-}
-
-inline uint32_t bitmix(const uint32_t mask, const uint32_t a, const uint32_t b) {
-#ifdef __MRISC32__
-  uint32_t result = a;
-  __asm volatile("sel.213 %[result],%[mask],%[b]"
-                 : [ result ] "+r"(result)
-                 : [ mask ] "r"(mask), [ b ] "r"(b));
-  return result;
-#else
-  return (a & mask) | (b & ~mask);
-#endif
+// Add the (already clipped) rectangle [x0, x1) x [y0, y1) to the dirty rectangle.
+inline void mark_dirty(fb_t* fb, const int x0, const int y0, const int x1, const int y1) {
+  auto& dirty = fb->dirty;
+  if (dirty.x1 <= dirty.x0) {
+    dirty.x0 = x0;
+    dirty.y0 = y0;
+    dirty.x1 = x1;
+    dirty.y1 = y1;
+  } else {
+    dirty.x0 = std::min(dirty.x0, x0);
+    dirty.y0 = std::min(dirty.y0, y0);
+    dirty.x1 = std::max(dirty.x1, x1);
+    dirty.y1 = std::max(dirty.y1, y1);
+  }
 }
 
 // TODO(m): Specialize this template for LOG2PPW == 0 (i.e. no head/tail necessary).
@@ -183,118 +161,1872 @@ void gfx_fill_rect_internal(fb_t* fb,
 #endif
 }
 
-}  // namespace
+// Floor and ceil of a / b (b != 0).
+inline int64_t floor_div(const int64_t a, const int64_t b) {
+  const auto q = a / b;
+  return (((a % b) != 0) && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
 
-extern "C" void gfx_clear(fb_t* fb, uint32_t color) {
-  gfx_fill_rect(fb, 0, 0, fb->width, fb->height, color);
+inline int64_t ceil_div(const int64_t a, const int64_t b) {
+  return -floor_div(-a, b);
 }
 
-extern "C" void gfx_fill_rect(fb_t* fb, int x0, int y0, int w, int h, uint32_t color) {
-  // Clamp to the framebuffer limits.
-  int x1 = std::max(0, std::min(x0 + w, fb->width));
-  int y1 = std::max(0, std::min(y0 + h, fb->height));
-  x0 = std::max(0, x0);
-  y0 = std::max(0, y0);
-  w = x1 - x0;
-  h = y1 - y0;
-  if (w <= 0 || h <= 0) {
+// Narrow the index range [i0, i1) so that the 16.16 fixed point coordinate p + i * dp is inside
+// the range [0, size) for all i in the range.
+void limit_span(const int32_t p, const int32_t dp, const int size, int& i0, int& i1) {
+  const int64_t lim = (static_cast<int64_t>(size) << 16) - 1;
+  int64_t lo;
+  int64_t hi;
+  if (dp > 0) {
+    lo = ceil_div(-static_cast<int64_t>(p), dp);
+    hi = floor_div(lim - p, dp) + 1;
+  } else if (dp < 0) {
+    lo = ceil_div(lim - p, dp);
+    hi = floor_div(-static_cast<int64_t>(p), dp) + 1;
+  } else if (p >= 0 && p <= lim) {
+    return;
+  } else {
+    i1 = i0;
+    return;
+  }
+  i0 = static_cast<int>(std::max(static_cast<int64_t>(i0), lo));
+  i1 = static_cast<int>(std::min(static_cast<int64_t>(i1), hi));
+}
+
+// Sample n source pixels along the 16.16 fixed point coordinates (u, v), stepping (du, dv) for
+// each pixel, and write them to the destination row starting at pixel x. The integer parts of the
+// source coordinates are and:ed with umask and vmask, respectively.
+template <int CMODE>
+void sample_span(void* dst_row,
+                 const int x,
+                 int n,
+                 const fb_t* src,
+                 uint32_t u,
+                 uint32_t v,
+                 const uint32_t du,
+                 const uint32_t dv,
+                 const uint32_t umask,
+                 const uint32_t vmask) {
+  using surface = mc1::surface_t<CMODE>;
+#ifdef __MRISC32_VECTOR_OPS__
+  if constexpr (CMODE == CMODE_RGBA8888 || CMODE == CMODE_PAL8) {
+    // Vectorized gather for PAL8 and RGBA8888. The source coordinates for VL pixels are kept in
+    // two vector registers (v1 = u, v2 = v), and are advanced by VL * (du, dv) per iteration.
+    constexpr auto LOG2PPW = surface::LOG2PPW;
+    auto* dst = &static_cast<uint8_t*>(dst_row)[x << (2 - LOG2PPW)];
+    const auto* src_pixels = src->pixels;
+    const uint32_t src_stride = src->stride >> (2 - LOG2PPW);
+    uint32_t du_vl;
+    uint32_t dv_vl;
+    if constexpr (CMODE == CMODE_PAL8) {
+      __asm volatile(
+          "getsr   vl, #0x10\n\t"
+          "ldea    v3, z, #1\n\t"
+          "mul     v1, v3, %[du]\n\t"
+          "add     v1, v1, %[u]\n\t"
+          "mul     v2, v3, %[dv]\n\t"
+          "add     v2, v2, %[v]\n\t"
+          "mul     %[du_vl], %[du], vl\n\t"
+          "mul     %[dv_vl], %[dv], vl\n"
+
+          "1:\n\t"
+          "min     vl, vl, %[n]\n\t"
+          "sub     %[n], %[n], vl\n\t"
+          "lsr     v3, v2, #16\n\t"
+          "lsr     v4, v1, #16\n\t"
+          "and     v3, v3, %[vmask]\n\t"
+          "and     v4, v4, %[umask]\n\t"
+          "mul     v3, v3, %[src_stride]\n\t"
+          "add     v1, v1, %[du_vl]\n\t"
+          "add     v3, v3, v4\n\t"
+          "add     v2, v2, %[dv_vl]\n\t"
+          "ldub    v3, %[src_pixels], v3\n\t"
+          "stb     v3, %[dst], #1\n\t"
+          "add     %[dst], %[dst], vl\n\t"
+          "bgt     %[n], 1b"
+          : [ dst ] "+r"(dst),
+            [ n ] "+r"(n),
+            [ du_vl ] "=&r"(du_vl),
+            [ dv_vl ] "=&r"(dv_vl)
+          : [ src_pixels ] "r"(src_pixels),
+            [ src_stride ] "r"(src_stride),
+            [ u ] "r"(u),
+            [ v ] "r"(v),
+            [ du ] "r"(du),
+            [ dv ] "r"(dv),
+            [ umask ] "r"(umask),
+            [ vmask ] "r"(vmask)
+          : "vl", "v1", "v2", "v3", "v4", "memory");
+    } else {
+      __asm volatile(
+          "getsr   vl, #0x10\n\t"
+          "ldea    v3, z, #1\n\t"
+          "mul     v1, v3, %[du]\n\t"
+          "add     v1, v1, %[u]\n\t"
+          "mul     v2, v3, %[dv]\n\t"
+          "add     v2, v2, %[v]\n\t"
+          "mul     %[du_vl], %[du], vl\n\t"
+          "mul     %[dv_vl], %[dv], vl\n"
+
+          "1:\n\t"
+          "min     vl, vl, %[n]\n\t"
+          "sub     %[n], %[n], vl\n\t"
+          "lsr     v3, v2, #16\n\t"
+          "lsr     v4, v1, #16\n\t"
+          "and     v3, v3, %[vmask]\n\t"
+          "and     v4, v4, %[umask]\n\t"
+          "mul     v3, v3, %[src_stride]\n\t"
+          "add     v1, v1, %[du_vl]\n\t"
+          "add     v3, v3, v4\n\t"
+          "add     v2, v2, %[dv_vl]\n\t"
+          "ldw     v3, %[src_pixels], v3*4\n\t"
+          "stw     v3, %[dst], #4\n\t"
+          "ldea    %[dst], %[dst], vl*4\n\t"
+          "bgt     %[n], 1b"
+          : [ dst ] "+r"(dst),
+            [ n ] "+r"(n),
+            [ du_vl ] "=&r"(du_vl),
+            [ dv_vl ] "=&r"(dv_vl)
+          : [ src_pixels ] "r"(src_pixels),
+            [ src_stride ] "r"(src_stride),
+            [ u ] "r"(u),
+            [ v ] "r"(v),
+            [ du ] "r"(du),
+            [ dv ] "r"(dv),
+            [ umask ] "r"(umask),
+            [ vmask ] "r"(vmask)
+          : "vl", "v1", "v2", "v3", "v4", "memory");
+    }
     return;
   }
+#endif
+
+  const auto* src_pixels = static_cast<const uint8_t*>(src->pixels);
+  const auto src_stride = src->stride;
+  for (int k = 0; k < n; ++k) {
+    const auto* src_row = &src_pixels[((v >> 16) & vmask) * src_stride];
+    const auto sample_x = static_cast<int>((u >> 16) & umask);
+    surface::put(dst_row, x + k, surface::get(src_row, sample_x));
+    u += du;
+    v += dv;
+  }
+}
 
-  switch (fb->mode) {
+// Average of two (packed) pixels, rounding down.
+template <int CMODE>
+inline uint32_t average_pixels(const uint32_t a, const uint32_t b) {
+  static_assert(CMODE == CMODE_RGBA8888 || CMODE == CMODE_RGBA5551,
+                "Averaging is only supported for RGBA8888 and RGBA5551");
+  // Mask out the least significant bit of each color component before shifting.
+  constexpr uint32_t MASK = (CMODE == CMODE_RGBA8888) ? 0xfefefefeU : 0x7bde7bdeU;
+  return (a & b) + (((a ^ b) & MASK) >> 1);
+}
+
+// Like sample_span(), but for axis aligned sampling (dv = 0) with a 2x2 box filter. The 2x2
+// samples are centered around the sample point u (offset by -half), and are clamped to the range
+// [xmin, xmax]. The two source rows are given by src_row0 and src_row1.
+template <int CMODE>
+void sample_span_box(void* dst_row,
+                     const int x,
+                     const int n,
+                     const void* src_row0,
+                     const void* src_row1,
+                     int32_t u,
+                     const int32_t du,
+                     const int32_t half,
+                     const int32_t xmin,
+                     const int32_t xmax) {
+  using surface = mc1::surface_t<CMODE>;
+  for (int k = 0; k < n; ++k) {
+    const auto x0 = static_cast<int>(std::max((u - half) >> 16, xmin));
+    const auto x1 = static_cast<int>(std::min((u + half) >> 16, xmax));
+    const auto a =
+        average_pixels<CMODE>(surface::get(src_row0, x0), surface::get(src_row0, x1));
+    const auto b =
+        average_pixels<CMODE>(surface::get(src_row1, x0), surface::get(src_row1, x1));
+    surface::put(dst_row, x + k, average_pixels<CMODE>(a, b));
+    u += du;
+  }
+}
+
+// Draw n line pixels, starting at (x, y). The error term err is in the range [0, 2 * d_major), and
+// the minor axis is stepped when it reaches 2 * d_major.
+template <int CMODE>
+void gfx_draw_line_internal(fb_t* fb,
+                            int x,
+                            const int y,
+                            const int sx,
+                            const int sy,
+                            const bool x_major,
+                            const int d_major,
+                            const int d_minor,
+                            int err,
+                            int n,
+                            const uint32_t color) {
+  using surface = mc1::surface_t<CMODE>;
+  const auto stride = static_cast<ptrdiff_t>(fb->stride);
+  auto* row = &static_cast<uint8_t*>(fb->pixels)[y * stride];
+  const int major_dx = x_major ? sx : 0;
+  const int minor_dx = x_major ? 0 : sx;
+  const auto major_drow = x_major ? 0 : sy * stride;
+  const auto minor_drow = x_major ? sy * stride : 0;
+  const int two_major = 2 * d_major;
+  const int two_minor = 2 * d_minor;
+  while (true) {
+    surface::put(row, x, color);
+    if (--n == 0) {
+      break;
+    }
+    x += major_dx;
+    row += major_drow;
+    err += two_minor;
+    if (err >= two_major) {
+      err -= two_major;
+      x += minor_dx;
+      row += minor_drow;
+    }
+  }
+}
+
+// Source mapping for the affine blit. The source coordinate (u, v) of destination pixel (i, j),
+// relative to the destination rectangle origin, is:
+//   u = u0 + i * du_dx + j * du_dy
+//   v = v0 + i * dv_dx + j * dv_dy
+// ...in 16.16 fixed point.
+struct affine_map_t {
+  int32_t u0;
+  int32_t v0;
+  int32_t du_dx;
+  int32_t du_dy;
+  int32_t dv_dx;
+  int32_t dv_dy;
+};
+
+template <int CMODE>
+void gfx_blit_affine_internal(fb_t* fb,
+                              const int dx,
+                              const int dy,
+                              const int dw,
+                              const int dh,
+                              const fb_t* src,
+                              const affine_map_t& map,
+                              const bool wrap) {
+  // Clamp to the clip rectangle.
+  const int i_min = std::max(0, fb->clip.x0 - dx);
+  const int i_max = std::min(dw, fb->clip.x1 - dx);
+  const int j_min = std::max(0, fb->clip.y0 - dy);
+  const int j_max = std::min(dh, fb->clip.y1 - dy);
+
+  if (i_min >= i_max || j_min >= j_max) {
+    return;
+  }
+  mark_dirty(fb, dx + i_min, dy + j_min, dx + i_max, dy + j_max);
+
+  const uint32_t umask = wrap ? static_cast<uint32_t>(src->width - 1) : 0xffffffffU;
+  const uint32_t vmask = wrap ? static_cast<uint32_t>(src->height - 1) : 0xffffffffU;
+
+  auto* dst_row = &static_cast<uint8_t*>(fb->pixels)[(dy + j_min) * fb->stride];
+  // Note: The coordinates are stepped using unsigned arithmetic, since they may wrap around.
+  uint32_t u_row = static_cast<uint32_t>(map.u0) + static_cast<uint32_t>(j_min * map.du_dy);
+  uint32_t v_row = static_cast<uint32_t>(map.v0) + static_cast<uint32_t>(j_min * map.dv_dy);
+  for (int j = j_min; j < j_max; ++j) {
+    // Find the range of pixels that map to the inside of the source image.
+    int i0 = i_min;
+    int i1 = i_max;
+    if (!wrap) {
+      limit_span(static_cast<int32_t>(u_row), map.du_dx, src->width, i0, i1);
+      limit_span(static_cast<int32_t>(v_row), map.dv_dx, src->height, i0, i1);
+    }
+
+    if (i0 < i1) {
+      const auto u = u_row + static_cast<uint32_t>(i0) * static_cast<uint32_t>(map.du_dx);
+      const auto v = v_row + static_cast<uint32_t>(i0) * static_cast<uint32_t>(map.dv_dx);
+      sample_span<CMODE>(dst_row,
+                         dx + i0,
+                         i1 - i0,
+                         src,
+                         u,
+                         v,
+                         static_cast<uint32_t>(map.du_dx),
+                         static_cast<uint32_t>(map.dv_dx),
+                         umask,
+                         vmask);
+    }
+
+    dst_row += fb->stride;
+    u_row += static_cast<uint32_t>(map.du_dy);
+    v_row += static_cast<uint32_t>(map.dv_dy);
+  }
+}
+
+template <int CMODE>
+void gfx_blit_box_internal(fb_t* fb,
+                           const int dx,
+                           const int dy,
+                           const int dw,
+                           const int dh,
+                           const fb_t* src,
+                           const int sx,
+                           const int sy,
+                           const int sw,
+                           const int sh,
+                           const affine_map_t& map) {
+  // Clamp to the clip rectangle, and to the source framebuffer limits (the range is the same for
+  // all rows).
+  int i0 = std::max(0, fb->clip.x0 - dx);
+  int i1 = std::min(dw, fb->clip.x1 - dx);
+  const int j_min = std::max(0, fb->clip.y0 - dy);
+  const int j_max = std::min(dh, fb->clip.y1 - dy);
+  limit_span(map.u0, map.du_dx, src->width, i0, i1);
+  if (i0 >= i1 || j_min >= j_max) {
+    return;
+  }
+  mark_dirty(fb, dx + i0, dy + j_min, dx + i1, dy + j_max);
+
+  // The 2x2 samples are placed at the centers of the four quadrants of the destination pixel
+  // footprint (at most half a source pixel from the center), and are clamped to the source
+  // rectangle.
+  const int32_t half_x = std::min(map.du_dx >> 2, 0x8000);
+  const int32_t half_y = std::min(map.dv_dy >> 2, 0x8000);
+  const int32_t xmin = std::max(sx, 0);
+  const int32_t xmax = std::min(sx + sw, src->width) - 1;
+  const int32_t ymin = std::max(sy, 0);
+  const int32_t ymax = std::min(sy + sh, src->height) - 1;
+
+  const auto* src_pixels = static_cast<const uint8_t*>(src->pixels);
+  const int32_t u = map.u0 + i0 * map.du_dx;
+  auto* dst_row = &static_cast<uint8_t*>(fb->pixels)[(dy + j_min) * fb->stride];
+  int32_t v = map.v0 + j_min * map.dv_dy;
+  for (int j = j_min; j < j_max; ++j) {
+    if (v >= 0 && (v >> 16) < src->height) {
+      const int y0 = std::max((v - half_y) >> 16, ymin);
+      const int y1 = std::min((v + half_y) >> 16, ymax);
+      sample_span_box<CMODE>(dst_row,
+                             dx + i0,
+                             i1 - i0,
+                             &src_pixels[y0 * src->stride],
+                             &src_pixels[y1 * src->stride],
+                             u,
+                             map.du_dx,
+                             half_x,
+                             xmin,
+                             xmax);
+    }
+
+    dst_row += fb->stride;
+    v += map.dv_dy;
+  }
+}
+
+inline int32_t to_fixed16(const float x) {
+  return static_cast<int32_t>(x * 65536.0f);
+}
+
+inline bool is_pow2(const int x) {
+  return (x & (x - 1)) == 0;
+}
+
+// Call func(std::integral_constant<int, CMODE>()) for the given color mode.
+template <typename FUNC>
+inline void dispatch_mode(const int mode, const FUNC& func) {
+  switch (mode) {
     case CMODE_PAL1:
-      gfx_fill_rect_internal<5>(fb, x0, y0, w, h, repeat32x1(color));
+      func(std::integral_constant<int, CMODE_PAL1>());
       break;
 
     case CMODE_PAL2:
-      gfx_fill_rect_internal<4>(fb, x0, y0, w, h, repeat16x2(color));
+      func(std::integral_constant<int, CMODE_PAL2>());
       break;
 
     case CMODE_PAL4:
-      gfx_fill_rect_internal<3>(fb, x0, y0, w, h, repeat8x4(color));
+      func(std::integral_constant<int, CMODE_PAL4>());
       break;
 
     case CMODE_PAL8:
-      gfx_fill_rect_internal<2>(fb, x0, y0, w, h, repeat4x8(color));
+      func(std::integral_constant<int, CMODE_PAL8>());
       break;
 
     case CMODE_RGBA5551:
-      gfx_fill_rect_internal<1>(fb, x0, y0, w, h, repeat2x16(color));
+      func(std::integral_constant<int, CMODE_RGBA5551>());
       break;
 
     case CMODE_RGBA8888:
-      gfx_fill_rect_internal<0>(fb, x0, y0, w, h, color);
+      func(std::integral_constant<int, CMODE_RGBA8888>());
       break;
   }
 }
 
-extern "C" void gfx_draw_point(fb_t* fb, int x, int y, uint32_t color) {
-  // Check if the point is inside the framebuffer limits.
-  if ((x < 0) || (y < 0) || (x >= fb->width) || (y >= fb->height)) {
-    return;
+//--------------------------------------------------------------------------------------------------
+// Blending (RGBA8888 and RGBA5551 only).
+//--------------------------------------------------------------------------------------------------
+
+template <int CMODE>
+constexpr bool can_blend = (CMODE == CMODE_RGBA8888 || CMODE == CMODE_RGBA5551);
+
+// Unsigned multiply of four bytes, keeping the high byte of each product: (a * b) >> 8.
+inline uint32_t mulhi_u8x4(const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32_PACKED_OPS__
+  return _mr32_mulhiu_b(a, b);
+#else
+  uint32_t r = 0U;
+  for (uint32_t shift = 0U; shift < 32U; shift += 8U) {
+    r |= ((((a >> shift) & 255U) * ((b >> shift) & 255U)) >> 8) << shift;
   }
+  return r;
+#endif
+}
 
-  switch (fb->mode) {
-    case CMODE_PAL1: {
-      auto* ptr = &static_cast<uint8_t*>(fb->pixels)[y * fb->stride + (x >> 3)];
-      const uint32_t shift = (x & 7);
-      const uint32_t mask = 0x01U << shift;
-      *ptr = bitmix(mask, color << shift, *ptr);
-    } break;
+// Unsigned saturating add of four bytes.
+inline uint32_t addsu_u8x4(const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32_PACKED_OPS__
+  return _mr32_addsu_b(a, b);
+#else
+  const uint32_t s = ((a & 0x7f7f7f7fU) + (b & 0x7f7f7f7fU)) ^ ((a ^ b) & 0x80808080U);
+  const uint32_t carry = ((a & b) | ((a | b) & ~s)) & 0x80808080U;
+  return s | ((carry >> 7) * 0xffU);
+#endif
+}
 
-    case CMODE_PAL2: {
-      auto* ptr = &static_cast<uint8_t*>(fb->pixels)[y * fb->stride + (x >> 2)];
-      const uint32_t shift = (x & 3) * 2;
-      const uint32_t mask = 0x03U << shift;
-      *ptr = bitmix(mask, color << shift, *ptr);
-    } break;
+// Saturating add of the color components of two pairs of RGBA5551 pixels. The five bit fields are
+// added in two groups (R+B and G) so that each field has a free bit above it to catch the carry,
+// which is then turned into a saturation mask.
+inline uint32_t addsu_5551x2(const uint32_t a, const uint32_t b) {
+  uint32_t rb = (a & 0x7c1f7c1fU) + (b & 0x7c1f7c1fU);
+  uint32_t carry = rb & 0x80208020U;
+  rb = (rb | (carry - (carry >> 5))) & 0x7c1f7c1fU;
+  uint32_t g = (a & 0x03e003e0U) + (b & 0x03e003e0U);
+  carry = g & 0x04000400U;
+  g = (g | (carry - (carry >> 5))) & 0x03e003e0U;
+  return rb | g;
+}
 
-    case CMODE_PAL4: {
-      auto* ptr = &static_cast<uint8_t*>(fb->pixels)[y * fb->stride + (x >> 1)];
-      const uint32_t shift = (x & 1) * 4;
-      const uint32_t mask = 0x0fU << shift;
-      *ptr = bitmix(mask, color << shift, *ptr);
-    } break;
+// Multiply the two 16-bit halves of a and b pairwise, keeping the low 16 bits of each product.
+inline uint32_t mul_u16x2(const uint32_t a, const uint32_t b) {
+#ifdef __MRISC32_PACKED_OPS__
+  uint32_t result;
+  __asm("mul.h %[result], %[a], %[b]" : [ result ] "=r"(result) : [ a ] "r"(a), [ b ] "r"(b));
+  return result;
+#else
+  return (((a & 0xffffU) * (b & 0xffffU)) & 0xffffU) | (((a >> 16) * (b >> 16)) << 16);
+#endif
+}
 
-    case CMODE_PAL8: {
-      auto* ptr = &static_cast<uint8_t*>(fb->pixels)[y * fb->stride + x];
-      *ptr = static_cast<uint8_t>(color);
-    } break;
+// Multiply the color components of two pairs of RGBA5551 pixels (approximately a * b / 31). Each
+// component (B, G and R) is multiplied for both pixels at once, with one pixel per 16-bit half,
+// which leaves room for the 10-bit products. The products are then renormalized with
+// (t + (t >> 5) + 1) >> 5 in both halves at once.
+inline uint32_t mul_5551x2(const uint32_t a, const uint32_t b) {
+  const uint32_t lane_mask = 0x001f001fU;
+  uint32_t t0 = mul_u16x2(a & lane_mask, b & lane_mask);
+  uint32_t t1 = mul_u16x2((a >> 5) & lane_mask, (b >> 5) & lane_mask);
+  uint32_t t2 = mul_u16x2((a >> 10) & lane_mask, (b >> 10) & lane_mask);
+  t0 = ((t0 + ((t0 >> 5) & lane_mask) + 0x00010001U) >> 5) & lane_mask;
+  t1 = ((t1 + ((t1 >> 5) & lane_mask) + 0x00010001U) >> 5) & lane_mask;
+  t2 = ((t2 + ((t2 >> 5) & lane_mask) + 0x00010001U) >> 5) & lane_mask;
+  return t0 | (t1 << 5) | (t2 << 10);
+}
 
-    case CMODE_RGBA5551: {
-      auto* ptr = &static_cast<uint16_t*>(fb->pixels)[y * (fb->stride >> 1) + x];
-      *ptr = static_cast<uint16_t>(color);
-    } break;
+// Blend a word of source pixels (s) with a word of destination pixels (d).
+template <int CMODE, int BLEND>
+inline uint32_t blend_word(const uint32_t d, const uint32_t s) {
+  static_assert(can_blend<CMODE>, "Blending is only supported for RGBA color modes");
+  if constexpr (CMODE == CMODE_RGBA8888) {
+    const uint32_t a = s >> 24;
+    if constexpr (BLEND == GFX_BLEND_OVER) {
+      // The source alpha is replaced by 255, so that the resulting alpha is a + d.a * (1 - a).
+      if (a == 255U) {
+        return s;
+      }
+      if (a == 0U) {
+        return d;
+      }
+      return addsu_u8x4(scale_u8x4(s | 0xff000000U, a), scale_u8x4(d, 255U - a));
+    } else if constexpr (BLEND == GFX_BLEND_ADD) {
+      const uint32_t t = (a == 255U) ? s : scale_u8x4(s, a);
+      return addsu_u8x4(d, t & 0x00ffffffU);
+    } else {
+      return (mulhi_u8x4(d, s) & 0x00ffffffU) | (d & 0xff000000U);
+    }
+  } else {
+    // Two pixels per word, with one bit alpha. Each pixel is either opaque or fully transparent.
+    const uint32_t alpha_mask = ((s >> 15) & 0x00010001U) * 0xffffU;
+    if constexpr (BLEND == GFX_BLEND_OVER) {
+      return bitmix(alpha_mask, s, d);
+    } else if constexpr (BLEND == GFX_BLEND_ADD) {
+      return addsu_5551x2(d, s & alpha_mask) | (d & 0x80008000U);
+    } else {
+      return mul_5551x2(d, s) | (d & 0x80008000U);
+    }
+  }
+}
 
-    case CMODE_RGBA8888: {
-      auto* ptr = &static_cast<uint32_t*>(fb->pixels)[y * (fb->stride >> 2) + x];
-      *ptr = color;
-    } break;
+// Blend n pixels, starting at pixel x of a destination row. The source pixels are read from
+// src_row (starting at pixel sx), or if src_row is nullptr, color_word is used as the source.
+template <int CMODE, int BLEND>
+void blend_row(void* dst_row,
+               const int x,
+               const void* src_row,
+               const int sx,
+               const uint32_t color_word,
+               const int n) {
+  using pixel_t = typename mc1::surface_t<CMODE>::pixel_t;
+  auto* dst = &static_cast<pixel_t*>(dst_row)[x];
+  const auto* src = (src_row != nullptr) ? &static_cast<const pixel_t*>(src_row)[sx] : nullptr;
+  if constexpr (CMODE == CMODE_RGBA8888) {
+    if (src != nullptr) {
+      for (int i = 0; i < n; ++i) {
+        dst[i] = blend_word<CMODE, BLEND>(dst[i], src[i]);
+      }
+    } else {
+      for (int i = 0; i < n; ++i) {
+        dst[i] = blend_word<CMODE, BLEND>(dst[i], color_word);
+      }
+    }
+  } else {
+    // Blend single pixels at the ends, and pairs of pixels (whole words) in between.
+    const auto blend_pixel = [&](const int i) {
+      const uint32_t s = (src != nullptr) ? src[i] : color_word;
+      dst[i] = static_cast<pixel_t>(blend_word<CMODE, BLEND>(dst[i], s));
+    };
+    int i = 0;
+    if ((x & 1) != 0 && n > 0) {
+      blend_pixel(0);
+      i = 1;
+    }
+    auto* dst_words = reinterpret_cast<uint32_t*>(&dst[i]);
+    if (src != nullptr) {
+      for (; i + 1 < n; i += 2) {
+        const uint32_t s =
+            static_cast<uint32_t>(src[i]) | (static_cast<uint32_t>(src[i + 1]) << 16);
+        *dst_words = blend_word<CMODE, BLEND>(*dst_words, s);
+        ++dst_words;
+      }
+    } else {
+      for (; i + 1 < n; i += 2) {
+        *dst_words = blend_word<CMODE, BLEND>(*dst_words, color_word);
+        ++dst_words;
+      }
+    }
+    if (i < n) {
+      blend_pixel(i);
+    }
   }
 }
 
-extern "C" void gfx_draw_line(fb_t* fb, int x0, int y0, int x1, int y1, uint32_t color) {
-  // This is an implementation of Bresenham's algorithm.
-  auto dx = std::abs(x1 - x0);
-  auto dy = -std::abs(y1 - y0);
-  int stepx = (x0 < x1) ? 1 : -1;
-  int stepy = (y0 < y1) ? 1 : -1;
-  auto err = dx + dy;
-  auto x = x0;
-  auto y = y0;
-  while (true) {
-    // TODO(m): Optimize me!
-    gfx_draw_point(fb, x, y, color);
-    if (x == x1 && y == y1)
+// Call func(std::integral_constant<int, BLEND>()) for the given blend mode (not GFX_BLEND_NONE).
+template <typename FUNC>
+inline void dispatch_blend(const int blend, const FUNC& func) {
+  switch (blend) {
+    case GFX_BLEND_OVER:
+      func(std::integral_constant<int, GFX_BLEND_OVER>());
+      break;
+
+    case GFX_BLEND_ADD:
+      func(std::integral_constant<int, GFX_BLEND_ADD>());
+      break;
+
+    case GFX_BLEND_MULTIPLY:
+      func(std::integral_constant<int, GFX_BLEND_MULTIPLY>());
       break;
-    auto e2 = 2 * err;
-    if (e2 >= dy) {
-      err += dy;
-      x += stepx;
+  }
+}
+
+// Value returned by solid_blend() when drawing with a solid color does not change any pixels.
+constexpr int BLEND_SKIP = -1;
+
+// Get the blend mode to use for drawing with a solid color. Opaque and fully transparent colors
+// do not need per-pixel blending.
+template <int CMODE>
+int solid_blend(const fb_t* fb, const uint32_t color) {
+  if constexpr (can_blend<CMODE>) {
+    using surface = mc1::surface_t<CMODE>;
+    const int blend = fb->blend;
+    if (blend == GFX_BLEND_OVER || blend == GFX_BLEND_ADD) {
+      constexpr uint32_t ALPHA_BITS = (CMODE == CMODE_RGBA8888) ? 8U : 1U;
+      const uint32_t alpha = (color & surface::PIXEL_MASK) >> (surface::BPP - ALPHA_BITS);
+      if (alpha == 0U) {
+        return BLEND_SKIP;
+      }
+      if (alpha == (1U << ALPHA_BITS) - 1U && blend == GFX_BLEND_OVER) {
+        return GFX_BLEND_NONE;
+      }
+    }
+    return blend;
+  } else {
+    (void)fb;
+    (void)color;
+    return GFX_BLEND_NONE;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Drawing primitives for a given color mode. These are the implementations of the public gfx_*
+// functions (after the color mode dispatch).
+//--------------------------------------------------------------------------------------------------
+
+template <int CMODE>
+void fill_rect(fb_t* fb, int x0, int y0, int w, int h, const uint32_t color) {
+  // Clamp to the clip rectangle.
+  const int x1 = std::min(x0 + w, fb->clip.x1);
+  const int y1 = std::min(y0 + h, fb->clip.y1);
+  x0 = std::max(fb->clip.x0, x0);
+  y0 = std::max(fb->clip.y0, y0);
+  w = x1 - x0;
+  h = y1 - y0;
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  const int blend = solid_blend<CMODE>(fb, color);
+  if (blend == BLEND_SKIP) {
+    return;
+  }
+  mark_dirty(fb, x0, y0, x1, y1);
+
+  using surface = mc1::surface_t<CMODE>;
+  if constexpr (can_blend<CMODE>) {
+    if (blend != GFX_BLEND_NONE) {
+      const surface surf(fb);
+      const auto color_word = surface::repeat(color);
+      dispatch_blend(blend, [&](auto b) {
+        for (int y = y0; y < y1; ++y) {
+          blend_row<CMODE, decltype(b)::value>(surf.row_ptr(y), x0, nullptr, 0, color_word, w);
+        }
+      });
+      return;
+    }
+  }
+
+  gfx_fill_rect_internal<surface::LOG2PPW>(fb, x0, y0, w, h, surface::repeat(color));
+}
+
+template <int CMODE>
+void draw_point(fb_t* fb, const int x, const int y, const uint32_t color) {
+  // Check if the point is inside the clip rectangle.
+  if ((x < fb->clip.x0) || (y < fb->clip.y0) || (x >= fb->clip.x1) || (y >= fb->clip.y1)) {
+    return;
+  }
+
+  mark_dirty(fb, x, y, x + 1, y + 1);
+  mc1::surface_t<CMODE>(fb).put(x, y, color);
+}
+
+template <int CMODE>
+void draw_line(fb_t* fb,
+               const int x0,
+               const int y0,
+               const int x1,
+               const int y1,
+               const uint32_t color) {
+  // This is a variant of Bresenham's algorithm. The line is stepped along the major axis, and for
+  // pixel k (k = 0..d_major) the minor axis offset is round(k * d_minor / d_major). Since the
+  // offset can be calculated directly for any k, the line is clipped analytically to a range of k
+  // before drawing.
+  const auto dx = std::abs(x1 - x0);
+  const auto dy = std::abs(y1 - y0);
+  const int sx = (x0 < x1) ? 1 : -1;
+  const int sy = (y0 < y1) ? 1 : -1;
+  const bool x_major = (dx >= dy);
+  const int d_major = x_major ? dx : dy;
+  const int d_minor = x_major ? dy : dx;
+
+  // Clip the major axis range.
+  int k0 = 0;
+  int k1 = d_major + 1;
+  {
+    const auto& c = fb->clip;
+    const int major0 = x_major ? x0 : y0;
+    const int s_major = x_major ? sx : sy;
+    const int lo = x_major ? c.x0 : c.y0;
+    const int hi = (x_major ? c.x1 : c.y1) - 1;
+    if (s_major > 0) {
+      k0 = std::max(k0, lo - major0);
+      k1 = std::min(k1, hi - major0 + 1);
+    } else {
+      k0 = std::max(k0, major0 - hi);
+      k1 = std::min(k1, major0 - lo + 1);
     }
-    if (e2 <= dx) {
-      err += dx;
-      y += stepy;
+  }
+
+  // Clip the minor axis range.
+  const int minor0 = x_major ? y0 : x0;
+  const int s_minor = x_major ? sy : sx;
+  {
+    const auto& c = fb->clip;
+    const int lo = x_major ? c.y0 : c.x0;
+    const int hi = (x_major ? c.y1 : c.x1) - 1;
+
+    // Range of allowed minor axis offsets, m.
+    const int64_t m_lo = (s_minor > 0) ? (lo - minor0) : (minor0 - hi);
+    const int64_t m_hi = (s_minor > 0) ? (hi - minor0) : (minor0 - lo);
+    if (d_minor == 0) {
+      if (m_lo > 0 || m_hi < 0) {
+        return;
+      }
+    } else {
+      // m(k) = floor((2 * k * d_minor + d_major) / (2 * d_major))
+      const int64_t two_major = 2 * static_cast<int64_t>(d_major);
+      const int64_t two_minor = 2 * static_cast<int64_t>(d_minor);
+      k0 = static_cast<int>(
+          std::max(static_cast<int64_t>(k0), ceil_div(two_major * m_lo - d_major, two_minor)));
+      const auto k_end = floor_div(two_major * (m_hi + 1) - d_major - 1, two_minor) + 1;
+      k1 = static_cast<int>(std::min(static_cast<int64_t>(k1), k_end));
     }
   }
+  if (k0 >= k1) {
+    return;
+  }
+
+  // Set up the stepping at the first visible pixel.
+  const int64_t e0 = 2 * static_cast<int64_t>(k0) * d_minor + d_major;
+  const int m0 = (d_major > 0) ? static_cast<int>(e0 / (2 * d_major)) : 0;
+  const int x = x0 + sx * (x_major ? k0 : m0);
+  const int y = y0 + sy * (x_major ? m0 : k0);
+  const int err = static_cast<int>(e0 - 2 * static_cast<int64_t>(m0) * d_major);
+
+  // The line is monotonic, so the bounding box is given by the first and the last pixel.
+  {
+    const int64_t e_last = 2 * static_cast<int64_t>(k1 - 1) * d_minor + d_major;
+    const int m_last = (d_major > 0) ? static_cast<int>(e_last / (2 * d_major)) : 0;
+    const int x_last = x0 + sx * (x_major ? (k1 - 1) : m_last);
+    const int y_last = y0 + sy * (x_major ? m_last : (k1 - 1));
+    mark_dirty(fb,
+               std::min(x, x_last),
+               std::min(y, y_last),
+               std::max(x, x_last) + 1,
+               std::max(y, y_last) + 1);
+  }
+
+  gfx_draw_line_internal<CMODE>(fb, x, y, sx, sy, x_major, d_major, d_minor, err, k1 - k0, color);
+}
+
+// Fills horizontal spans with a solid color (honoring the clip rectangle and the blend mode), and
+// marks the bounding rectangle of all filled spans as dirty when it goes out of scope.
+template <int CMODE>
+class span_filler_t {
+public:
+  using surface = mc1::surface_t<CMODE>;
+
+  span_filler_t(fb_t* fb, const uint32_t color)
+      : m_fb(fb), m_color_word(surface::repeat(color)), m_blend(solid_blend<CMODE>(fb, color)) {
+  }
+
+  ~span_filler_t() {
+    if (m_x0 < m_x1) {
+      mark_dirty(m_fb, m_x0, m_y0, m_x1, m_y1);
+    }
+  }
+
+  // Fill the pixels [x0, x1) of row y.
+  void fill(int x0, int x1, const int y) {
+    const auto& clip = m_fb->clip;
+    x0 = std::max(x0, clip.x0);
+    x1 = std::min(x1, clip.x1);
+    if (y < clip.y0 || y >= clip.y1 || x0 >= x1 || m_blend == BLEND_SKIP) {
+      return;
+    }
+
+    bool blended = false;
+    if constexpr (can_blend<CMODE>) {
+      if (m_blend != GFX_BLEND_NONE) {
+        auto* row = surface(m_fb).row_ptr(y);
+        dispatch_blend(m_blend, [&](auto b) {
+          blend_row<CMODE, decltype(b)::value>(row, x0, nullptr, 0, m_color_word, x1 - x0);
+        });
+        blended = true;
+      }
+    }
+    if (!blended) {
+      gfx_fill_rect_internal<surface::LOG2PPW>(m_fb, x0, y, x1 - x0, 1, m_color_word);
+    }
+
+    m_x0 = std::min(m_x0, x0);
+    m_y0 = std::min(m_y0, y);
+    m_x1 = std::max(m_x1, x1);
+    m_y1 = std::max(m_y1, y + 1);
+  }
+
+private:
+  fb_t* const m_fb;
+  const uint32_t m_color_word;
+  const int m_blend;
+  int m_x0 = INT32_MAX;
+  int m_y0 = INT32_MAX;
+  int m_x1 = INT32_MIN;
+  int m_y1 = INT32_MIN;
+};
+
+// Rasterize a "stretched" ellipse with the radii (a, b) into horizontal spans. The upper left
+// quarter of the ellipse is centered at (x0, y0), and the right and bottom halves are moved ex and
+// ey pixels to the right and down, respectively (the gaps are bridged by straight edges). This
+// covers ellipses and circles (ex = ey = 0) as well as rounded rectangles.
+//
+// The spans are passed to span_func(x0, x1, y), for the pixels [x0, x1) of row y. No pixel is
+// covered by more than one span.
+template <typename SPAN_FUNC>
+void rasterize_ellipse(const int x0,
+                       const int y0,
+                       const int ex,
+                       const int ey,
+                       const int a,
+                       const int b,
+                       const bool fill,
+                       const SPAN_FUNC& span_func) {
+  // Rows with straight edges.
+  const int left = x0 - a;
+  const int right = x0 + ex + a;
+  for (int y = y0 + 1; y < y0 + ey; ++y) {
+    if (fill || right - left <= 1) {
+      span_func(left, right + 1, y);
+    } else {
+      span_func(left, left + 1, y);
+      span_func(right, right + 1, y);
+    }
+  }
+
+  // Curved rows. The half width of row dy (relative to the center) is the largest x for which
+  // b^2 x^2 + a^2 dy^2 <= a^2 b^2 + t, where t = a b (a + b) / 2 moves the edge out by about half
+  // a pixel (so that pixels are included if their centers are inside the ellipse). Since the half
+  // width decreases with dy, it is found by stepping x down from the previous row's value.
+  const int64_t a2 = static_cast<int64_t>(a) * a;
+  const int64_t b2 = static_cast<int64_t>(b) * b;
+  const int64_t limit = a2 * b2 + (static_cast<int64_t>(a) * b * (a + b)) / 2;
+  int x = a;
+  const auto half_width = [&](const int dy) {
+    const int64_t dy_term = a2 * dy * dy;
+    while (x >= 0 && b2 * x * x + dy_term > limit) {
+      --x;
+    }
+    return x;
+  };
+
+  int xo = half_width(0);
+  for (int dy = 0; dy <= b; ++dy) {
+    // The outline of this row reaches in to (but not including) the half width of the next row.
+    // The last row (dy = b, or where the next half width is negative) is drawn in full.
+    const int xi = (dy < b) ? half_width(dy + 1) : -1;
+    const int inner = std::min(xi + 1, xo);
+    const int y_top = y0 - dy;
+    const int y_bottom = y0 + ey + dy;
+    for (const int y : {y_top, y_bottom}) {
+      if (fill || xi < 0 || ex + 2 * inner <= 1) {
+        span_func(x0 - xo, x0 + ex + xo + 1, y);
+      } else {
+        span_func(x0 - xo, x0 - inner + 1, y);
+        span_func(x0 + ex + inner, x0 + ex + xo + 1, y);
+      }
+      if (y_bottom == y_top) {
+        break;
+      }
+    }
+    xo = xi;
+  }
+}
+
+template <int CMODE>
+void draw_ellipse(fb_t* fb,
+                  const int x0,
+                  const int y0,
+                  const int ex,
+                  const int ey,
+                  const int a,
+                  const int b,
+                  const bool fill,
+                  const uint32_t color) {
+  if (a < 0 || b < 0 || ex < 0 || ey < 0) {
+    return;
+  }
+  span_filler_t<CMODE> filler(fb, color);
+  rasterize_ellipse(
+      x0, y0, ex, ey, a, b, fill, [&](int x, int x_end, int y) { filler.fill(x, x_end, y); });
+}
+
+template <int CMODE>
+void draw_arc(fb_t* fb,
+              const int cx,
+              const int cy,
+              const int r,
+              const float start,
+              const float end,
+              const uint32_t color) {
+  if (r < 0) {
+    return;
+  }
+
+  // A pixel (relative to the center) is inside the sector if it is on the positive side of the
+  // start direction and on the negative side of the end direction (for sectors up to 180 degrees),
+  // or if it is not inside the complementary sector (for sectors larger than 180 degrees).
+  const float sweep = end - start;
+  const bool full = sweep >= 6.2831853f;
+  const bool large = sweep > 3.1415927f;
+  const float sx = std::cos(start);
+  const float sy = std::sin(start);
+  const float ex = std::cos(end);
+  const float ey = std::sin(end);
+  const auto inside = [&](const float dx, const float dy) {
+    const float cross_s = sx * dy - sy * dx;
+    const float cross_e = dx * ey - dy * ex;
+    return large ? !(cross_s < 0.0f && cross_e < 0.0f) : (cross_s >= 0.0f && cross_e >= 0.0f);
+  };
+
+  span_filler_t<CMODE> filler(fb, color);
+  rasterize_ellipse(cx, cy, 0, 0, r, r, false, [&](const int x0, const int x1, const int y) {
+    if (full) {
+      filler.fill(x0, x1, y);
+      return;
+    }
+    // Split the span into runs of pixels that are inside the sector.
+    const auto dy = static_cast<float>(y - cy);
+    int run_start = x0;
+    for (int x = x0; x < x1; ++x) {
+      if (!inside(static_cast<float>(x - cx), dy)) {
+        filler.fill(run_start, x, y);
+        run_start = x + 1;
+      }
+    }
+    filler.fill(run_start, x1, y);
+  });
+}
+
+template <int CMODE>
+void draw_thick_line(fb_t* fb,
+                     const int x0,
+                     const int y0,
+                     const int x1,
+                     const int y1,
+                     const int width,
+                     const uint32_t color) {
+  if (width <= 1) {
+    draw_line<CMODE>(fb, x0, y0, x1, y1, color);
+    return;
+  }
+
+  // The line is drawn as a rectangle (i.e. with square ends at the end points), whose corners are
+  // the end points (pixel centers) offset by half the line width along the line normal.
+  auto dx = static_cast<float>(x1 - x0);
+  auto dy = static_cast<float>(y1 - y0);
+  const float len = std::sqrt(dx * dx + dy * dy);
+  if (len > 0.0f) {
+    dx /= len;
+    dy /= len;
+  } else {
+    dx = 1.0f;
+  }
+  const float half_width = 0.5f * static_cast<float>(width);
+  const float nx = -dy * half_width;
+  const float ny = dx * half_width;
+  const float px[4] = {static_cast<float>(x0) + 0.5f + nx,
+                       static_cast<float>(x1) + 0.5f + nx,
+                       static_cast<float>(x1) + 0.5f - nx,
+                       static_cast<float>(x0) + 0.5f - nx};
+  const float py[4] = {static_cast<float>(y0) + 0.5f + ny,
+                       static_cast<float>(y1) + 0.5f + ny,
+                       static_cast<float>(y1) + 0.5f - ny,
+                       static_cast<float>(y0) + 0.5f - ny};
+
+  // Scan convert the rectangle: For each row, find the range of pixel centers that are between
+  // the left and right edge crossings.
+  const float min_y = std::min(std::min(py[0], py[1]), std::min(py[2], py[3]));
+  const float max_y = std::max(std::max(py[0], py[1]), std::max(py[2], py[3]));
+  const int row0 = std::max(static_cast<int>(std::floor(min_y)), fb->clip.y0);
+  const int row1 = std::min(static_cast<int>(std::ceil(max_y)), fb->clip.y1);
+  span_filler_t<CMODE> filler(fb, color);
+  for (int y = row0; y < row1; ++y) {
+    const float yc = static_cast<float>(y) + 0.5f;
+    float xl = INFINITY;
+    float xr = -INFINITY;
+    for (int i = 0; i < 4; ++i) {
+      const int j = (i + 1) & 3;
+      if ((py[i] <= yc) != (py[j] <= yc)) {
+        const float x = px[i] + (yc - py[i]) * (px[j] - px[i]) / (py[j] - py[i]);
+        xl = std::min(xl, x);
+        xr = std::max(xr, x);
+      }
+    }
+    if (xl < xr) {
+      const auto x_start = static_cast<int>(std::ceil(xl - 0.5f));
+      const auto x_end = static_cast<int>(std::ceil(xr - 0.5f));
+      filler.fill(x_start, x_end, y);
+    }
+  }
+}
+
+template <int CMODE>
+void blit_scaled(fb_t* fb,
+                 const int dx,
+                 const int dy,
+                 const int dw,
+                 const int dh,
+                 const fb_t* src,
+                 const int sx,
+                 const int sy,
+                 const int sw,
+                 const int sh,
+                 const uint32_t flags) {
+  if (src->mode != fb->mode || dw <= 0 || dh <= 0 || sw <= 0 || sh <= 0) {
+    return;
+  }
+
+  // Sample the source image at the pixel centers.
+  affine_map_t map;
+  map.du_dx = static_cast<int32_t>((static_cast<int64_t>(sw) << 16) / dw);
+  map.dv_dy = static_cast<int32_t>((static_cast<int64_t>(sh) << 16) / dh);
+  map.du_dy = 0;
+  map.dv_dx = 0;
+  map.u0 = (sx << 16) + (map.du_dx >> 1);
+  map.v0 = (sy << 16) + (map.dv_dy >> 1);
+
+  if constexpr (CMODE == CMODE_RGBA8888 || CMODE == CMODE_RGBA5551) {
+    if ((flags & GFX_BLIT_BOX) != 0) {
+      gfx_blit_box_internal<CMODE>(fb, dx, dy, dw, dh, src, sx, sy, sw, sh, map);
+      return;
+    }
+  }
+
+  gfx_blit_affine_internal<CMODE>(fb, dx, dy, dw, dh, src, map, false);
+}
+
+// Copy n words (the destination may overlap the source if it is at a lower address).
+inline void copy_words(uint32_t* dst, const uint32_t* src, int n) {
+#ifdef __MRISC32_VECTOR_OPS__
+  __asm volatile(
+      "getsr   vl, #0x10\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[n]\n\t"
+      "sub     %[n], %[n], vl\n\t"
+      "ldw     v1, %[src], #4\n\t"
+      "ldea    %[src], %[src], vl*4\n\t"
+      "stw     v1, %[dst], #4\n\t"
+      "ldea    %[dst], %[dst], vl*4\n\t"
+      "bgt     %[n], 1b"
+      : [ dst ] "+r"(dst), [ src ] "+r"(src), [ n ] "+r"(n)
+      :
+      : "vl", "v1", "memory");
+#else
+  memmove(dst, src, static_cast<size_t>(n) * 4U);
+#endif
+}
+
+// Copy n pixels from pixel sx of the source row to pixel dx of the destination row.
+template <int CMODE>
+void copy_row(void* dst_row, const int dx, const void* src_row, const int sx, const int n) {
+  using surface = mc1::surface_t<CMODE>;
+  constexpr auto LOG2PPW = surface::LOG2PPW;
+  constexpr auto PPW = surface::PPW;
+  constexpr auto BPP = surface::BPP;
+
+  const auto first = static_cast<uint32_t>(dx) & (PPW - 1U);
+  if (first != (static_cast<uint32_t>(sx) & (PPW - 1U))) {
+    // Different sub-word alignment.
+    if constexpr (BPP >= 8U) {
+      memmove(&static_cast<uint8_t*>(dst_row)[(dx * BPP) / 8U],
+             &static_cast<const uint8_t*>(src_row)[(sx * BPP) / 8U],
+             (n * BPP) / 8U);
+    } else {
+      for (int k = 0; k < n; ++k) {
+        surface::put(dst_row, dx + k, surface::get(src_row, sx + k));
+      }
+    }
+    return;
+  }
+
+  // Same sub-word alignment: Copy whole words, and merge partial words at the ends.
+  auto* dst = &static_cast<uint32_t*>(dst_row)[dx >> LOG2PPW];
+  const auto* src = &static_cast<const uint32_t*>(src_row)[sx >> LOG2PPW];
+  const auto end = first + static_cast<uint32_t>(n);
+  const auto low_bits = [](const uint32_t k) {
+    return (k < PPW) ? ((1U << (k * BPP)) - 1U) : 0xffffffffU;
+  };
+  if (end <= PPW) {
+    *dst = bitmix(low_bits(end) & ~low_bits(first), *src, *dst);
+    return;
+  }
+  if (first != 0U) {
+    *dst = bitmix(~low_bits(first), *src, *dst);
+    ++dst;
+    ++src;
+  }
+  const auto num_words = static_cast<int>((end >> LOG2PPW) - (first != 0U ? 1U : 0U));
+  if (num_words > 0) {
+    copy_words(dst, src, num_words);
+  }
+  const auto tail = end & (PPW - 1U);
+  if (tail != 0U) {
+    dst[num_words] = bitmix(low_bits(tail), src[num_words], dst[num_words]);
+  }
+}
+
+template <int CMODE>
+void blit(fb_t* fb, int dx, int dy, const fb_t* src, int sx, int sy, int w, int h) {
+  if (src->mode != fb->mode) {
+    return;
+  }
+
+  // Clamp to the source framebuffer limits.
+  if (sx < 0) {
+    dx -= sx;
+    w += sx;
+    sx = 0;
+  }
+  if (sy < 0) {
+    dy -= sy;
+    h += sy;
+    sy = 0;
+  }
+  w = std::min(w, src->width - sx);
+  h = std::min(h, src->height - sy);
+
+  // Clamp to the clip rectangle.
+  const auto& clip = fb->clip;
+  if (dx < clip.x0) {
+    sx += clip.x0 - dx;
+    w -= clip.x0 - dx;
+    dx = clip.x0;
+  }
+  if (dy < clip.y0) {
+    sy += clip.y0 - dy;
+    h -= clip.y0 - dy;
+    dy = clip.y0;
+  }
+  w = std::min(w, clip.x1 - dx);
+  h = std::min(h, clip.y1 - dy);
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+  mark_dirty(fb, dx, dy, dx + w, dy + h);
+
+  const mc1::surface_t<CMODE> dst_surf(fb);
+  const mc1::surface_t<CMODE> src_surf(const_cast<fb_t*>(src));
+  const auto blit_rows = [&](const auto& row_func) {
+    if (src == fb && dy == sy && dx > sx) {
+      // Overlapping copy to the right within the same rows: Copy each row via a temporary buffer.
+      // This is only used for scrolling within a framebuffer, so it does not have to be fast.
+      constexpr int TMP_PIXELS = 256;
+      uint32_t tmp[(TMP_PIXELS * mc1::surface_t<CMODE>::BPP) / 32];
+      for (int y = 0; y < h; ++y) {
+        for (int x = w; x > 0;) {
+          const int n = std::min(x, TMP_PIXELS);
+          x -= n;
+          copy_row<CMODE>(tmp, 0, src_surf.row_ptr(sy + y), sx + x, n);
+          row_func(dst_surf.row_ptr(dy + y), dx + x, tmp, 0, n);
+        }
+      }
+    } else if (src == fb && dy > sy) {
+      // Overlapping copy downwards: Copy the rows from bottom to top.
+      for (int y = h - 1; y >= 0; --y) {
+        row_func(dst_surf.row_ptr(dy + y), dx, src_surf.row_ptr(sy + y), sx, w);
+      }
+    } else {
+      for (int y = 0; y < h; ++y) {
+        row_func(dst_surf.row_ptr(dy + y), dx, src_surf.row_ptr(sy + y), sx, w);
+      }
+    }
+  };
+
+  if constexpr (can_blend<CMODE>) {
+    if (fb->blend != GFX_BLEND_NONE) {
+      dispatch_blend(fb->blend, [&](auto b) {
+        blit_rows([](void* dst_row, int x, const void* src_row, int src_x, int n) {
+          blend_row<CMODE, decltype(b)::value>(dst_row, x, src_row, src_x, 0U, n);
+        });
+      });
+      return;
+    }
+  }
+  blit_rows(copy_row<CMODE>);
+}
+
+// Expansion of 8x8 font glyph rows to pixel masks. Each set bit of a glyph row (bit 0 is the
+// leftmost pixel) is expanded to a full pixel mask, using a look-up table for groups of up to four
+// pixels.
+template <int CMODE>
+struct glyph_expander_t {
+  using surface = mc1::surface_t<CMODE>;
+
+  // Pixels per look-up table entry.
+  static constexpr uint32_t NB = (surface::PPW < 4U) ? surface::PPW : 4U;
+
+  // Number of words that hold the pixels of an entire glyph row.
+  static constexpr uint32_t NUM_WORDS = (8U * surface::BPP + 31U) / 32U;
+
+  constexpr glyph_expander_t() : lut() {
+    for (uint32_t i = 0U; i < (1U << NB); ++i) {
+      uint32_t mask = 0U;
+      for (uint32_t k = 0U; k < NB; ++k) {
+        if ((i & (1U << k)) != 0U) {
+          mask |= surface::PIXEL_MASK << (k * surface::BPP);
+        }
+      }
+      lut[i] = mask;
+    }
+  }
+
+  void expand(const uint32_t bits, uint32_t* words) const {
+    for (uint32_t i = 0U; i < NUM_WORDS; ++i) {
+      words[i] = 0U;
+    }
+    for (uint32_t k = 0U; k < 8U / NB; ++k) {
+      const uint32_t bit_pos = k * NB * surface::BPP;
+      words[bit_pos / 32U] |= lut[(bits >> (k * NB)) & ((1U << NB) - 1U)] << (bit_pos & 31U);
+    }
+  }
+
+  uint32_t lut[1U << NB];
+};
+
+template <int CMODE>
+constexpr glyph_expander_t<CMODE> s_glyph_expander{};
+
+template <int CMODE, int BLEND>
+void draw_text_internal(fb_t* fb,
+                        const int x0,
+                        int y,
+                        const char* text,
+                        const uint32_t fg,
+                        const uint32_t bg,
+                        const uint32_t flags) {
+  using surface = mc1::surface_t<CMODE>;
+  using expander = glyph_expander_t<CMODE>;
+  constexpr auto NUM_WORDS = expander::NUM_WORDS;
+  const auto& exp = s_glyph_expander<CMODE>;
+
+  const auto& clip = fb->clip;
+  const bool transparent = (flags & GFX_TEXT_TRANSPARENT) != 0;
+  const auto fg_word = surface::repeat(fg);
+  const auto bg_word = surface::repeat(bg);
+  const surface surf(fb);
+
+  // Pixel masks for fully visible glyphs.
+  uint32_t full_cell[NUM_WORDS];
+  exp.expand(0xffU, full_cell);
+
+  while (*text != 0) {
+    // Find the visible rows for this line of text.
+    const int row0 = std::max(0, clip.y0 - y);
+    const int row1 = std::min(8, clip.y1 - y);
+
+    int x = x0;
+    const char* line_start = text;
+    for (; *text != 0 && *text != '\n'; ++text, x += 8) {
+      // Find the visible columns of this glyph.
+      const int col0 = std::max(0, clip.x0 - x);
+      const int col1 = std::min(8, clip.x1 - x);
+      if (row0 >= row1 || col0 >= col1) {
+        continue;
+      }
+
+      uint32_t cell[NUM_WORDS];
+      if (col0 == 0 && col1 == 8) {
+        for (uint32_t i = 0U; i < NUM_WORDS; ++i) {
+          cell[i] = full_cell[i];
+        }
+      } else {
+        exp.expand((0xffU << col0) & (0xffU >> (8 - col1)), cell);
+      }
+
+      // Non-printable characters are drawn as spaces.
+      auto c = static_cast<uint32_t>(static_cast<uint8_t>(*text));
+      if (c < 32U || c > 127U) {
+        c = 32U;
+      }
+      const auto* glyph = &mc1_font_8x8[(c - 32U) * 8U];
+
+      // The glyph row is shifted into place within the destination words.
+      const uint32_t shift = (static_cast<uint32_t>(x) & (surface::PPW - 1U)) * surface::BPP;
+      const uint32_t shift_r = 32U - shift;
+      for (int row = row0; row < row1; ++row) {
+        uint32_t bits[NUM_WORDS];
+        exp.expand(glyph[row], bits);
+
+        auto* dst = &static_cast<uint32_t*>(surf.row_ptr(y + row))[x >> surface::LOG2PPW];
+        for (uint32_t i = 0U; i <= NUM_WORDS; ++i) {
+          uint32_t b = (i < NUM_WORDS) ? (bits[i] << shift) : 0U;
+          uint32_t m = (i < NUM_WORDS) ? (cell[i] << shift) : 0U;
+          if constexpr (surface::PPW > 1U) {
+            if (i > 0U && shift != 0U) {
+              b |= bits[i - 1U] >> shift_r;
+              m |= cell[i - 1U] >> shift_r;
+            }
+          }
+          if (m == 0U) {
+            continue;
+          }
+          if constexpr (BLEND != GFX_BLEND_NONE) {
+            const auto fg_blend = blend_word<CMODE, BLEND>(dst[i], fg_word);
+            if (transparent) {
+              dst[i] = bitmix(b & m, fg_blend, dst[i]);
+            } else {
+              const auto bg_blend = blend_word<CMODE, BLEND>(dst[i], bg_word);
+              dst[i] = bitmix(m, bitmix(b, fg_blend, bg_blend), dst[i]);
+            }
+          } else if (transparent) {
+            dst[i] = bitmix(b & m, fg_word, dst[i]);
+          } else {
+            dst[i] = bitmix(m, bitmix(b, fg_word, bg_word), dst[i]);
+          }
+        }
+      }
+    }
+
+    // Mark the visible part of the line as dirty.
+    const int line_x0 = std::max(x0, clip.x0);
+    const int line_x1 = std::min(x, clip.x1);
+    if (text != line_start && row0 < row1 && line_x0 < line_x1) {
+      mark_dirty(fb, line_x0, y + row0, line_x1, y + row1);
+    }
+
+    if (*text == '\n') {
+      ++text;
+      y += 8;
+    }
+  }
+}
+
+template <int CMODE>
+void draw_text(fb_t* fb,
+               const int x,
+               const int y,
+               const char* text,
+               const uint32_t fg,
+               const uint32_t bg,
+               const uint32_t flags) {
+  if constexpr (can_blend<CMODE>) {
+    if (fb->blend != GFX_BLEND_NONE) {
+      dispatch_blend(fb->blend, [&](auto b) {
+        draw_text_internal<CMODE, decltype(b)::value>(fb, x, y, text, fg, bg, flags);
+      });
+      return;
+    }
+  }
+  draw_text_internal<CMODE, GFX_BLEND_NONE>(fb, x, y, text, fg, bg, flags);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Command lists.
+//
+// Commands are stored back to back in the command buffer. Each command starts with a header that
+// gives the command type, the size of the command (in bytes) and the range of rows that the
+// command may touch (used for skipping commands that do not intersect a band).
+//--------------------------------------------------------------------------------------------------
+
+enum cmd_type_t : uint16_t {
+  CMD_FILL_RECT,
+  CMD_DRAW_POINT,
+  CMD_DRAW_LINE,
+  CMD_BLIT_SCALED,
+  CMD_DRAW_TEXT,
+  CMD_PUSH_CLIP,
+  CMD_POP_CLIP,
+  CMD_SET_BLEND
+};
+
+// Number of rows per band when executing a command list.
+constexpr int CMD_BAND_HEIGHT = 16;
+
+// Sentinel value for gfx_cmdlist_t::last.
+constexpr size_t CMD_NONE = ~static_cast<size_t>(0);
+
+// The rows that are touched by clip commands.
+constexpr int CMD_ALL_ROWS_Y0 = -0x7fffffff;
+constexpr int CMD_ALL_ROWS_Y1 = 0x7fffffff;
+
+struct cmd_header_t {
+  cmd_type_t type;
+  uint16_t size;
+  int y0;
+  int y1;
+};
+
+struct cmd_rect_t {
+  cmd_header_t hdr;
+  int x;
+  int y;
+  int w;
+  int h;
+  uint32_t color;
+};
+
+struct cmd_line_t {
+  cmd_header_t hdr;
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+  uint32_t color;
+};
+
+struct cmd_text_t {
+  cmd_header_t hdr;
+  int x;
+  int y;
+  uint32_t fg;
+  uint32_t bg;
+  uint32_t flags;
+  char text[1];  // Variable length (zero terminated).
+};
+
+struct cmd_pop_clip_t {
+  cmd_header_t hdr;
+};
+
+struct cmd_blend_t {
+  cmd_header_t hdr;
+  int blend;
+};
+
+struct cmd_blit_t {
+  cmd_header_t hdr;
+  const fb_t* src;
+  int dx;
+  int dy;
+  int dw;
+  int dh;
+  int sx;
+  int sy;
+  int sw;
+  int sh;
+  uint32_t flags;
+};
+
+constexpr size_t cmd_size(const size_t size) {
+  return (size + alignof(void*) - 1) & ~(alignof(void*) - 1);
+}
+
+template <typename T>
+T* cmd_alloc(gfx_cmdlist_t* cl,
+             const cmd_type_t type,
+             const int y0,
+             const int y1,
+             const size_t extra_size = 0) {
+  const auto SIZE = cmd_size(sizeof(T) + extra_size);
+  if (cl->used + SIZE > cl->size || SIZE > 0xffffU) {
+    cl->overflow = 1;
+    return nullptr;
+  }
+  auto* cmd = reinterpret_cast<T*>(&cl->buf[cl->used]);
+  cmd->hdr.type = type;
+  cmd->hdr.size = static_cast<uint16_t>(SIZE);
+  cmd->hdr.y0 = y0;
+  cmd->hdr.y1 = y1;
+  cl->last = cl->used;
+  cl->used += SIZE;
+  return cmd;
+}
+
+// Try to merge a fill with the last command of the list. This is possible when the last command
+// is a fill with the same color, and the two rectangles together form a single rectangle.
+bool cmd_merge_fill(gfx_cmdlist_t* cl,
+                    const int x,
+                    const int y,
+                    const int w,
+                    const int h,
+                    const uint32_t color) {
+  if (cl->last == CMD_NONE) {
+    return false;
+  }
+  auto* last = reinterpret_cast<cmd_rect_t*>(&cl->buf[cl->last]);
+  if (last->hdr.type != CMD_FILL_RECT || last->color != color) {
+    return false;
+  }
+  if (last->x == x && last->w == w && last->y + last->h == y) {
+    last->h += h;
+  } else if (last->x == x && last->w == w && y + h == last->y) {
+    last->y = y;
+    last->h += h;
+  } else if (last->y == y && last->h == h && last->x + last->w == x) {
+    last->w += w;
+  } else if (last->y == y && last->h == h && x + w == last->x) {
+    last->x = x;
+    last->w += w;
+  } else {
+    return false;
+  }
+  last->hdr.y0 = last->y;
+  last->hdr.y1 = last->y + last->h;
+  return true;
+}
+
+template <int CMODE>
+void execute_band(const gfx_cmdlist_t* cl, fb_t* fb, const int band_y0, const int band_y1) {
+  for (size_t pos = 0; pos < cl->used;) {
+    const auto* hdr = reinterpret_cast<const cmd_header_t*>(&cl->buf[pos]);
+    pos += hdr->size;
+    if (hdr->y1 <= band_y0 || hdr->y0 >= band_y1) {
+      continue;
+    }
+
+    switch (hdr->type) {
+      case CMD_FILL_RECT: {
+        const auto* cmd = reinterpret_cast<const cmd_rect_t*>(hdr);
+        fill_rect<CMODE>(fb, cmd->x, cmd->y, cmd->w, cmd->h, cmd->color);
+      } break;
+
+      case CMD_DRAW_POINT: {
+        const auto* cmd = reinterpret_cast<const cmd_rect_t*>(hdr);
+        draw_point<CMODE>(fb, cmd->x, cmd->y, cmd->color);
+      } break;
+
+      case CMD_DRAW_LINE: {
+        const auto* cmd = reinterpret_cast<const cmd_line_t*>(hdr);
+        draw_line<CMODE>(fb, cmd->x0, cmd->y0, cmd->x1, cmd->y1, cmd->color);
+      } break;
+
+      case CMD_BLIT_SCALED: {
+        const auto* cmd = reinterpret_cast<const cmd_blit_t*>(hdr);
+        blit_scaled<CMODE>(fb,
+                             cmd->dx,
+                             cmd->dy,
+                             cmd->dw,
+                             cmd->dh,
+                             cmd->src,
+                             cmd->sx,
+                             cmd->sy,
+                             cmd->sw,
+                             cmd->sh,
+                             cmd->flags);
+      } break;
+
+      case CMD_DRAW_TEXT: {
+        const auto* cmd = reinterpret_cast<const cmd_text_t*>(hdr);
+        draw_text<CMODE>(fb, cmd->x, cmd->y, cmd->text, cmd->fg, cmd->bg, cmd->flags);
+      } break;
+
+      case CMD_PUSH_CLIP: {
+        const auto* cmd = reinterpret_cast<const cmd_rect_t*>(hdr);
+        fb_push_clip(fb, cmd->x, cmd->y, cmd->w, cmd->h);
+      } break;
+
+      case CMD_POP_CLIP:
+        fb_pop_clip(fb);
+        break;
+
+      case CMD_SET_BLEND:
+        fb->blend = reinterpret_cast<const cmd_blend_t*>(hdr)->blend;
+        break;
+    }
+  }
+}
+
+template <int CMODE>
+void execute(const gfx_cmdlist_t* cl, fb_t* fb) {
+  // The commands are executed one band of rows at a time, by clipping all commands against the
+  // band. This keeps the memory accesses local, while preserving the drawing order.
+  const auto clip = fb->clip;
+  const auto clip_depth = fb->clip_depth;
+  const auto blend = fb->blend;
+  for (int band_y0 = clip.y0; band_y0 < clip.y1; band_y0 += CMD_BAND_HEIGHT) {
+    const int band_y1 = std::min(band_y0 + CMD_BAND_HEIGHT, clip.y1);
+    fb->clip.y0 = band_y0;
+    fb->clip.y1 = band_y1;
+    execute_band<CMODE>(cl, fb, band_y0, band_y1);
+
+    // Restore the drawing state (in case the clip commands were not balanced).
+    fb->clip = clip;
+    fb->clip_depth = clip_depth;
+    fb->blend = blend;
+  }
+}
+
+// Draw a rounded rectangle as a stretched ellipse.
+void round_rect(fb_t* fb,
+                const int x,
+                const int y,
+                const int w,
+                const int h,
+                int r,
+                const bool fill,
+                const uint32_t color) {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+  r = std::max(0, std::min(r, std::min((w - 1) / 2, (h - 1) / 2)));
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_ellipse<decltype(cmode)::value>(
+        fb, x + r, y + r, w - 1 - 2 * r, h - 1 - 2 * r, r, r, fill, color);
+  });
+}
+
+}  // namespace
+
+extern "C" void gfx_set_blend(fb_t* fb, int blend) {
+  fb->blend = blend;
+}
+
+extern "C" void gfx_clear(fb_t* fb, uint32_t color) {
+  const int blend = fb->blend;
+  fb->blend = GFX_BLEND_NONE;
+  gfx_fill_rect(fb, 0, 0, fb->width, fb->height, color);
+  fb->blend = blend;
+}
+
+extern "C" void gfx_fill_rect(fb_t* fb, int x0, int y0, int w, int h, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    fill_rect<decltype(cmode)::value>(fb, x0, y0, w, h, color);
+  });
+}
+
+extern "C" void gfx_draw_point(fb_t* fb, int x, int y, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_point<decltype(cmode)::value>(fb, x, y, color);
+  });
+}
+
+extern "C" void gfx_draw_line(fb_t* fb, int x0, int y0, int x1, int y1, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_line<decltype(cmode)::value>(fb, x0, y0, x1, y1, color);
+  });
+}
+
+extern "C" void gfx_draw_circle(fb_t* fb, int cx, int cy, int r, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_ellipse<decltype(cmode)::value>(fb, cx, cy, 0, 0, r, r, false, color);
+  });
+}
+
+extern "C" void gfx_fill_circle(fb_t* fb, int cx, int cy, int r, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_ellipse<decltype(cmode)::value>(fb, cx, cy, 0, 0, r, r, true, color);
+  });
+}
+
+extern "C" void gfx_draw_ellipse(fb_t* fb, int cx, int cy, int rx, int ry, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_ellipse<decltype(cmode)::value>(fb, cx, cy, 0, 0, rx, ry, false, color);
+  });
+}
+
+extern "C" void gfx_fill_ellipse(fb_t* fb, int cx, int cy, int rx, int ry, uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_ellipse<decltype(cmode)::value>(fb, cx, cy, 0, 0, rx, ry, true, color);
+  });
+}
+
+extern "C" void gfx_draw_arc(fb_t* fb,
+                             int cx,
+                             int cy,
+                             int r,
+                             float start,
+                             float end,
+                             uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_arc<decltype(cmode)::value>(fb, cx, cy, r, start, end, color);
+  });
+}
+
+extern "C" void gfx_draw_round_rect(fb_t* fb, int x, int y, int w, int h, int r, uint32_t color) {
+  round_rect(fb, x, y, w, h, r, false, color);
+}
+
+extern "C" void gfx_fill_round_rect(fb_t* fb, int x, int y, int w, int h, int r, uint32_t color) {
+  round_rect(fb, x, y, w, h, r, true, color);
+}
+
+extern "C" void gfx_draw_thick_line(fb_t* fb,
+                                    int x0,
+                                    int y0,
+                                    int x1,
+                                    int y1,
+                                    int width,
+                                    uint32_t color) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_thick_line<decltype(cmode)::value>(fb, x0, y0, x1, y1, width, color);
+  });
+}
+
+extern "C" void gfx_blit(fb_t* fb, int dx, int dy, const fb_t* src, int sx, int sy, int w, int h) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    blit<decltype(cmode)::value>(fb, dx, dy, src, sx, sy, w, h);
+  });
+}
+
+extern "C" void gfx_blit_scaled(fb_t* fb,
+                                int dx,
+                                int dy,
+                                int dw,
+                                int dh,
+                                const fb_t* src,
+                                int sx,
+                                int sy,
+                                int sw,
+                                int sh,
+                                uint32_t flags) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    blit_scaled<decltype(cmode)::value>(fb, dx, dy, dw, dh, src, sx, sy, sw, sh, flags);
+  });
+}
+
+extern "C" void gfx_blit_affine(fb_t* fb,
+                                int dx,
+                                int dy,
+                                int dw,
+                                int dh,
+                                const fb_t* src,
+                                const float* m,
+                                uint32_t flags) {
+  if (src->mode != fb->mode || dw <= 0 || dh <= 0) {
+    return;
+  }
+
+  const bool wrap = (flags & GFX_BLIT_WRAP) != 0;
+  if (wrap && !(is_pow2(src->width) && is_pow2(src->height))) {
+    return;
+  }
+
+  // Sample the source image at the pixel centers.
+  affine_map_t map;
+  map.du_dx = to_fixed16(m[0]);
+  map.du_dy = to_fixed16(m[1]);
+  map.dv_dx = to_fixed16(m[3]);
+  map.dv_dy = to_fixed16(m[4]);
+  map.u0 = to_fixed16(0.5f * (m[0] + m[1]) + m[2]);
+  map.v0 = to_fixed16(0.5f * (m[3] + m[4]) + m[5]);
+
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    gfx_blit_affine_internal<decltype(cmode)::value>(fb, dx, dy, dw, dh, src, map, wrap);
+  });
+}
+
+extern "C" void gfx_draw_text(fb_t* fb,
+                              int x,
+                              int y,
+                              const char* text,
+                              uint32_t fg,
+                              uint32_t bg,
+                              uint32_t flags) {
+  dispatch_mode(fb->mode, [&](auto cmode) {
+    draw_text<decltype(cmode)::value>(fb, x, y, text, fg, bg, flags);
+  });
+}
+
+extern "C" void gfx_cmdlist_init(gfx_cmdlist_t* cl, void* buf, size_t size) {
+  cl->buf = static_cast<uint8_t*>(buf);
+  cl->size = size;
+  gfx_cmdlist_clear(cl);
+}
+
+extern "C" void gfx_cmdlist_clear(gfx_cmdlist_t* cl) {
+  cl->used = 0;
+  cl->last = CMD_NONE;
+  cl->overflow = 0;
+}
+
+extern "C" void gfx_cmd_fill_rect(gfx_cmdlist_t* cl, int x0, int y0, int w, int h, uint32_t color) {
+  if (w <= 0 || h <= 0 || cmd_merge_fill(cl, x0, y0, w, h, color)) {
+    return;
+  }
+  auto* cmd = cmd_alloc<cmd_rect_t>(cl, CMD_FILL_RECT, y0, y0 + h);
+  if (cmd != nullptr) {
+    cmd->x = x0;
+    cmd->y = y0;
+    cmd->w = w;
+    cmd->h = h;
+    cmd->color = color;
+  }
+}
+
+extern "C" void gfx_cmd_draw_point(gfx_cmdlist_t* cl, int x, int y, uint32_t color) {
+  auto* cmd = cmd_alloc<cmd_rect_t>(cl, CMD_DRAW_POINT, y, y + 1);
+  if (cmd != nullptr) {
+    cmd->x = x;
+    cmd->y = y;
+    cmd->w = 1;
+    cmd->h = 1;
+    cmd->color = color;
+  }
+}
+
+extern "C" void gfx_cmd_draw_line(gfx_cmdlist_t* cl,
+                                  int x0,
+                                  int y0,
+                                  int x1,
+                                  int y1,
+                                  uint32_t color) {
+  auto* cmd = cmd_alloc<cmd_line_t>(cl, CMD_DRAW_LINE, std::min(y0, y1), std::max(y0, y1) + 1);
+  if (cmd != nullptr) {
+    cmd->x0 = x0;
+    cmd->y0 = y0;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    cmd->color = color;
+  }
+}
+
+extern "C" void gfx_cmd_blit_scaled(gfx_cmdlist_t* cl,
+                                    int dx,
+                                    int dy,
+                                    int dw,
+                                    int dh,
+                                    const fb_t* src,
+                                    int sx,
+                                    int sy,
+                                    int sw,
+                                    int sh,
+                                    uint32_t flags) {
+  auto* cmd = cmd_alloc<cmd_blit_t>(cl, CMD_BLIT_SCALED, dy, dy + dh);
+  if (cmd != nullptr) {
+    cmd->src = src;
+    cmd->dx = dx;
+    cmd->dy = dy;
+    cmd->dw = dw;
+    cmd->dh = dh;
+    cmd->sx = sx;
+    cmd->sy = sy;
+    cmd->sw = sw;
+    cmd->sh = sh;
+    cmd->flags = flags;
+  }
+}
+
+extern "C" void gfx_cmd_draw_text(gfx_cmdlist_t* cl,
+                                  int x,
+                                  int y,
+                                  const char* text,
+                                  uint32_t fg,
+                                  uint32_t bg,
+                                  uint32_t flags) {
+  // Find the length of the text and the number of text lines.
+  size_t len = 0;
+  int num_lines = 1;
+  for (; text[len] != 0; ++len) {
+    if (text[len] == '\n') {
+      ++num_lines;
+    }
+  }
+
+  auto* cmd = cmd_alloc<cmd_text_t>(cl, CMD_DRAW_TEXT, y, y + 8 * num_lines, len);
+  if (cmd != nullptr) {
+    cmd->x = x;
+    cmd->y = y;
+    cmd->fg = fg;
+    cmd->bg = bg;
+    cmd->flags = flags;
+    memcpy(&cmd->text[0], text, len + 1);
+  }
+}
+
+extern "C" void gfx_cmd_set_blend(gfx_cmdlist_t* cl, int blend) {
+  auto* cmd = cmd_alloc<cmd_blend_t>(cl, CMD_SET_BLEND, CMD_ALL_ROWS_Y0, CMD_ALL_ROWS_Y1);
+  if (cmd != nullptr) {
+    cmd->blend = blend;
+  }
+}
+
+extern "C" void gfx_cmd_push_clip(gfx_cmdlist_t* cl, int x, int y, int w, int h) {
+  auto* cmd = cmd_alloc<cmd_rect_t>(cl, CMD_PUSH_CLIP, CMD_ALL_ROWS_Y0, CMD_ALL_ROWS_Y1);
+  if (cmd != nullptr) {
+    cmd->x = x;
+    cmd->y = y;
+    cmd->w = w;
+    cmd->h = h;
+    cmd->color = 0;
+  }
+}
+
+extern "C" void gfx_cmd_pop_clip(gfx_cmdlist_t* cl) {
+  cmd_alloc<cmd_pop_clip_t>(cl, CMD_POP_CLIP, CMD_ALL_ROWS_Y0, CMD_ALL_ROWS_Y1);
+}
+
+extern "C" void gfx_cmdlist_execute(const gfx_cmdlist_t* cl, fb_t* fb) {
+  dispatch_mode(fb->mode, [&](auto cmode) { execute<decltype(cmode)::value>(cl, fb); });
 }
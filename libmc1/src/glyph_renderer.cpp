@@ -20,6 +20,9 @@
 
 #include <mc1/glyph_renderer.h>
 
+#include <mc1/glyph_font.h>
+#include <mc1/memory.h>
+
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
@@ -59,14 +62,246 @@ uint8_t addsu(const uint8_t a, const uint8_t b) {
 #endif
 }
 
+// Apply a 3x3 Gaussian kernel to pixels 1..width-2 of the row row2 (row1 and row3 are the rows
+// above and below). Pixels 0 and width-1 of dst are not written.
+void blur_row(uint8_t* dst,
+              const uint8_t* row1,
+              const uint8_t* row2,
+              const uint8_t* row3,
+              const unsigned width) {
+#ifdef __MRISC32_VECTOR_OPS__
+  // Same as the scalar version: The center, edge and corner sums are shifted by 6 bits before they
+  // are weighted. The weights are applied with shifts: 12a = 8a + 4a, 5a = 4a + a.
+  unsigned count = width - 2u;
+  ++dst;
+  const uint8_t* p1;
+  const uint8_t* p2;
+  const uint8_t* p3;
+  __asm volatile(
+      "getsr   vl, #0x10\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[count]\n\t"
+      "sub     %[count], %[count], vl\n\t"
+
+      // Corners (v1) and center (v2) of the 3x3 area.
+      "ldub    v1, %[row1], #1\n\t"
+      "ldub    v3, %[row3], #1\n\t"
+      "add     %[p1], %[row1], #2\n\t"
+      "add     %[p3], %[row3], #2\n\t"
+      "add     v1, v1, v3\n\t"
+      "ldub    v2, %[p1], #1\n\t"
+      "ldub    v3, %[p3], #1\n\t"
+      "add     v1, v1, v2\n\t"
+      "add     v1, v1, v3\n\t"
+      "add     %[p2], %[row2], #1\n\t"
+      "ldub    v2, %[p2], #1\n\t"
+
+      // Edges (v3) of the 3x3 area.
+      "ldub    v3, %[row2], #1\n\t"
+      "add     %[p2], %[row2], #2\n\t"
+      "ldub    v4, %[p2], #1\n\t"
+      "add     v3, v3, v4\n\t"
+      "add     %[p1], %[row1], #1\n\t"
+      "add     %[p3], %[row3], #1\n\t"
+      "ldub    v4, %[p1], #1\n\t"
+      "ldub    v5, %[p3], #1\n\t"
+      "add     v3, v3, v4\n\t"
+      "add     v3, v3, v5\n\t"
+
+      // 12 * (center >> 6) + 8 * (edges >> 6) + 5 * (corners >> 6).
+      "lsr     v1, v1, #6\n\t"
+      "lsr     v2, v2, #6\n\t"
+      "lsr     v3, v3, #6\n\t"
+      "lsl     v4, v2, #3\n\t"
+      "lsl     v2, v2, #2\n\t"
+      "add     v2, v2, v4\n\t"
+      "lsl     v3, v3, #3\n\t"
+      "add     v2, v2, v3\n\t"
+      "lsl     v4, v1, #2\n\t"
+      "add     v2, v2, v1\n\t"
+      "add     v2, v2, v4\n\t"
+      "stb     v2, %[dst], #1\n\t"
+
+      "add     %[row1], %[row1], vl\n\t"
+      "add     %[row2], %[row2], vl\n\t"
+      "add     %[row3], %[row3], vl\n\t"
+      "add     %[dst], %[dst], vl\n\t"
+      "bgt     %[count], 1b"
+      : [ dst ] "+r"(dst),
+        [ row1 ] "+r"(row1),
+        [ row2 ] "+r"(row2),
+        [ row3 ] "+r"(row3),
+        [ count ] "+r"(count),
+        [ p1 ] "=&r"(p1),
+        [ p2 ] "=&r"(p2),
+        [ p3 ] "=&r"(p3)
+      :
+      : "vl", "v1", "v2", "v3", "v4", "v5", "memory");
+#else
+  // Read the first two columns of the 3x3 area.
+  uint32_t p11 = static_cast<uint32_t>(row1[0]);
+  uint32_t p12 = static_cast<uint32_t>(row1[1]);
+  uint32_t p21 = static_cast<uint32_t>(row2[0]);
+  uint32_t p22 = static_cast<uint32_t>(row2[1]);
+  uint32_t p31 = static_cast<uint32_t>(row3[0]);
+  uint32_t p32 = static_cast<uint32_t>(row3[1]);
+
+  for (unsigned x = 1u; x < width - 1u; ++x) {
+    // Read the last column of the 3x3 area.
+    uint32_t p13 = static_cast<uint32_t>(row1[x + 1]);
+    uint32_t p23 = static_cast<uint32_t>(row2[x + 1]);
+    uint32_t p33 = static_cast<uint32_t>(row3[x + 1]);
+
+    // 3x3 Gaussian kernel.
+    const uint32_t d0 = p22;
+    const uint32_t d1 = p12 + p21 + p23 + p32;
+    const uint32_t d2 = p11 + p13 + p31 + p33;
+    dst[x] = static_cast<uint8_t>(12 * (d0 >> 6) + 8 * (d1 >> 6) + 5 * (d2 >> 6));
+
+    // Shift all pixels to the left.
+    p11 = p12;
+    p12 = p13;
+    p21 = p22;
+    p22 = p23;
+    p31 = p32;
+    p32 = p33;
+  }
+#endif
+}
+
+// dst[x] = addsu(dst[x], src[x]) for a row of width pixels (a multiple of 4, word aligned).
+void addsu_row(uint8_t* dst, const uint8_t* src, const unsigned width) {
+#if defined(__MRISC32_VECTOR_OPS__) && defined(__MRISC32_PACKED_OPS__)
+  unsigned count = width / 4u;
+  __asm volatile(
+      "getsr   vl, #0x10\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[count]\n\t"
+      "sub     %[count], %[count], vl\n\t"
+      "ldw     v1, %[dst], #4\n\t"
+      "ldw     v2, %[src], #4\n\t"
+      "addsu.b v1, v1, v2\n\t"
+      "stw     v1, %[dst], #4\n\t"
+      "ldea    %[dst], %[dst], vl*4\n\t"
+      "ldea    %[src], %[src], vl*4\n\t"
+      "bgt     %[count], 1b"
+      : [ dst ] "+r"(dst), [ src ] "+r"(src), [ count ] "+r"(count)
+      :
+      : "vl", "v1", "v2", "memory");
+#elif defined(__MRISC32_PACKED_OPS__)
+  auto* d = reinterpret_cast<uint8x4_t*>(dst);
+  const auto* s = reinterpret_cast<const uint8x4_t*>(src);
+  for (unsigned k = 0; k < width / 4u; ++k) {
+    d[k] = _mr32_addsu_b(d[k], s[k]);
+  }
+#else
+  for (unsigned x = 0; x < width; ++x) {
+    dst[x] = addsu(dst[x], src[x]);
+  }
+#endif
+}
+
+// Pack a row of width 8-bit coverage values (a multiple of 4, word aligned) to 2 bpp.
+void pack_2bpp_row(uint8_t* dst, const uint8_t* src, const unsigned width) {
+#ifdef __MRISC32_VECTOR_OPS__
+  // Four coverage values (c1..c4) are read as one word, and the two most significant bits of each
+  // byte are gathered into one output byte: (c4 & 0xc0) | (c3 & 0xc0) >> 2 | ... | c1 >> 6.
+  unsigned count = width / 4u;
+  __asm volatile(
+      "getsr   vl, #0x10\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[count]\n\t"
+      "sub     %[count], %[count], vl\n\t"
+      "ldw     v1, %[src], #4\n\t"
+      "lsr     v1, v1, #6\n\t"
+      "and     v1, v1, %[mask]\n\t"
+      "lsr     v2, v1, #6\n\t"
+      "or      v1, v1, v2\n\t"
+      "lsr     v2, v1, #12\n\t"
+      "and     v1, v1, #0x0f\n\t"
+      "and     v2, v2, #0xf0\n\t"
+      "or      v1, v1, v2\n\t"
+      "stb     v1, %[dst], #1\n\t"
+      "ldea    %[src], %[src], vl*4\n\t"
+      "add     %[dst], %[dst], vl\n\t"
+      "bgt     %[count], 1b"
+      : [ dst ] "+r"(dst), [ src ] "+r"(src), [ count ] "+r"(count)
+      : [ mask ] "r"(0x03030303u)
+      : "vl", "v1", "v2", "memory");
+#else
+  for (unsigned x = 0; x < width; x += 4) {
+    const uint32_t c1 = static_cast<uint32_t>(*src++);
+    const uint32_t c2 = static_cast<uint32_t>(*src++);
+    const uint32_t c3 = static_cast<uint32_t>(*src++);
+    const uint32_t c4 = static_cast<uint32_t>(*src++);
+    *dst++ = static_cast<uint8_t>((c4 & 0xc0u) | ((c3 & 0xc0u) >> 2) | ((c2 & 0xc0u) >> 4) |
+                                  (c1 >> 6));
+  }
+#endif
+}
+
+// Pack a row of width 8-bit coverage values (a multiple of 2) to 4 bpp.
+void pack_4bpp_row(uint8_t* dst, const uint8_t* src, const unsigned width) {
+  for (unsigned x = 0; x < width; x += 2) {
+    const uint32_t c1 = static_cast<uint32_t>(*src++);
+    const uint32_t c2 = static_cast<uint32_t>(*src++);
+    *dst++ = static_cast<uint8_t>((c2 & 0xf0u) | (c1 >> 4));
+  }
+}
+
+// Pack a row of width 8-bit coverage values (a multiple of 8) to 1 bpp (pixels that are at least
+// half covered are set).
+void pack_1bpp_row(uint8_t* dst, const uint8_t* src, const unsigned width) {
+  for (unsigned x = 0; x < width; x += 8) {
+    uint32_t bits = 0u;
+    for (unsigned k = 0; k < 8; ++k) {
+      bits |= (static_cast<uint32_t>(*src++) >> 7) << k;
+    }
+    *dst++ = static_cast<uint8_t>(bits);
+  }
+}
+
+// Pack rows of 8-bit coverage values to 8, 4, 2 or 1 bpp.
+void paint_rows(const uint8_t* src,
+                const unsigned src_stride,
+                const unsigned width,
+                const unsigned height,
+                uint8_t* pix,
+                const unsigned stride,
+                const unsigned bpp) {
+  if (src == nullptr || width == 0u) {
+    return;
+  }
+  for (unsigned y = 0; y < height; ++y) {
+    switch (bpp) {
+      case 8:
+        memcpy(pix, src, width);
+        break;
+      case 4:
+        pack_4bpp_row(pix, src, width);
+        break;
+      case 2:
+        pack_2bpp_row(pix, src, width);
+        break;
+      default:
+        pack_1bpp_row(pix, src, width);
+        break;
+    }
+    src += src_stride;
+    pix += stride;
+  }
+}
+
 //--------------------------------------------------------------------------------------------------
 // Font definition.
 //--------------------------------------------------------------------------------------------------
 
-enum point_kind_t { PNT_REGULAR = 0, PNT_BEZIER = 1, PNT_END = 2, PNT_LAST = 3 };
+using namespace glyph_font;
 
 struct point_t {
-  point_t(const uint32_t p);
   point_t(const uint32_t p, const uint32_t shift_x, const uint32_t shift_y);
 
   float x;
@@ -74,563 +309,271 @@ struct point_t {
   point_kind_t kind;
 };
 
-point_t::point_t(const uint32_t p) {
-  kind = static_cast<point_kind_t>((p >> 6) & 3u);
-}
-
 point_t::point_t(const uint32_t p, const uint32_t shift_x, const uint32_t shift_y) {
   x = static_cast<float>((((p >> 3) & 7u) + 1) << shift_x);
   y = static_cast<float>(((p & 7u) + 1) << shift_y);
   kind = static_cast<point_kind_t>((p >> 6) & 3u);
 }
 
-constexpr uint8_t PP(const uint8_t x, const uint8_t y, const point_kind_t kind) {
-  return static_cast<uint8_t>(((static_cast<uint8_t>(kind) & 3u) << 6) | ((x & 7u) << 3) | (y & 7));
-}
-
-const uint8_t FONT[] = {'A',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 6, PNT_END),
-                        PP(2, 4, PNT_REGULAR),
-                        PP(4, 4, PNT_LAST),
-
-                        'B',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(5, 0, PNT_BEZIER),
-                        PP(5, 2, PNT_REGULAR),
-                        PP(5, 3, PNT_BEZIER),
-                        PP(3, 3, PNT_END),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(3, 3, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(6, 5, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(4, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_LAST),
-
-                        'C',
-                        PP(6, 0, PNT_REGULAR),
-                        PP(4, 0, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(0, 3, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(4, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        'D',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 3, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(0, 6, PNT_LAST),
-
-                        'E',
-                        PP(6, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_END),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(4, 3, PNT_LAST),
-
-                        'F',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_END),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(4, 3, PNT_LAST),
-
-                        'G',
-                        PP(6, 0, PNT_REGULAR),
-                        PP(4, 0, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(0, 3, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(4, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_REGULAR),
-                        PP(6, 3, PNT_REGULAR),
-                        PP(3, 3, PNT_LAST),
-
-                        'H',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(0, 6, PNT_END),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(6, 6, PNT_END),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(5, 3, PNT_LAST),
-
-                        'I',
-                        PP(2, 0, PNT_REGULAR),
-                        PP(4, 0, PNT_END),
-                        PP(2, 6, PNT_REGULAR),
-                        PP(4, 6, PNT_END),
-                        PP(3, 1, PNT_REGULAR),
-                        PP(3, 5, PNT_LAST),
-
-                        'J',
-                        PP(1, 0, PNT_REGULAR),
-                        PP(5, 0, PNT_REGULAR),
-                        PP(5, 4, PNT_REGULAR),
-                        PP(5, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(1, 6, PNT_BEZIER),
-                        PP(1, 4, PNT_LAST),
-
-                        'K',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(0, 6, PNT_END),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        'L',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(0, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        'M',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(3, 4, PNT_REGULAR),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        'N',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 6, PNT_REGULAR),
-                        PP(6, 0, PNT_LAST),
-
-                        'O',
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 3, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 3, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_LAST),
-
-                        'P',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 1, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(1, 3, PNT_LAST),
-
-                        'Q',
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 3, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 3, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_END),
-                        PP(3, 4, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        'R',
-                        PP(0, 6, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 1, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(1, 3, PNT_END),
-                        PP(2, 3, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        'S',
-                        PP(6, 1, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(0, 1, PNT_REGULAR),
-                        PP(0, 3, PNT_BEZIER),
-                        PP(3, 3, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(6, 5, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 5, PNT_LAST),
-
-                        'T',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_END),
-                        PP(3, 1, PNT_REGULAR),
-                        PP(3, 6, PNT_LAST),
-
-                        'U',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(0, 3, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(6, 3, PNT_REGULAR),
-                        PP(6, 0, PNT_LAST),
-
-                        'V',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(6, 0, PNT_LAST),
-
-                        'W',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(1, 6, PNT_REGULAR),
-                        PP(3, 3, PNT_REGULAR),
-                        PP(5, 6, PNT_REGULAR),
-                        PP(6, 0, PNT_LAST),
-
-                        'X',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 6, PNT_END),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(0, 6, PNT_LAST),
-
-                        'Y',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(3, 4, PNT_REGULAR),
-                        PP(3, 6, PNT_END),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(3, 4, PNT_LAST),
-
-                        'Z',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(0, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_END),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(5, 3, PNT_LAST),
-
-                        '0',
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 3, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 3, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_END),
-                        PP(3, 2, PNT_REGULAR),
-                        PP(3, 4, PNT_LAST),
-
-                        '1',
-                        PP(1, 2, PNT_REGULAR),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(3, 6, PNT_LAST),
-
-                        '2',
-                        PP(0, 1, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 1, PNT_REGULAR),
-                        PP(6, 2, PNT_BEZIER),
-                        PP(4, 3, PNT_REGULAR),
-                        PP(0, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_LAST),
-
-                        '3',
-                        PP(0, 1, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 1, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(3, 3, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(6, 5, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 5, PNT_LAST),
-
-                        '4',
-                        PP(6, 4, PNT_REGULAR),
-                        PP(0, 4, PNT_REGULAR),
-                        PP(5, 0, PNT_REGULAR),
-                        PP(5, 6, PNT_LAST),
-
-                        '5',
-                        PP(6, 0, PNT_REGULAR),
-                        PP(0, 0, PNT_REGULAR),
-                        PP(0, 2, PNT_REGULAR),
-                        PP(2, 2, PNT_REGULAR),
-                        PP(6, 2, PNT_BEZIER),
-                        PP(6, 4, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 5, PNT_LAST),
-
-                        '6',
-                        PP(5, 0, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(0, 4, PNT_REGULAR),
-                        PP(0, 3, PNT_BEZIER),
-                        PP(3, 3, PNT_REGULAR),
-                        PP(6, 3, PNT_BEZIER),
-                        PP(6, 4, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 3, PNT_LAST),
-
-                        '7',
-                        PP(0, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_REGULAR),
-                        PP(4, 2, PNT_REGULAR),
-                        PP(2, 3, PNT_BEZIER),
-                        PP(2, 6, PNT_END),
-                        PP(1, 3, PNT_REGULAR),
-                        PP(5, 3, PNT_LAST),
-
-                        '8',
-                        PP(3, 2, PNT_REGULAR),
-                        PP(1, 2, PNT_BEZIER),
-                        PP(1, 1, PNT_REGULAR),
-                        PP(1, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(5, 0, PNT_BEZIER),
-                        PP(5, 1, PNT_REGULAR),
-                        PP(5, 2, PNT_BEZIER),
-                        PP(3, 2, PNT_REGULAR),
-                        PP(6, 2, PNT_BEZIER),
-                        PP(6, 4, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(0, 6, PNT_BEZIER),
-                        PP(0, 4, PNT_REGULAR),
-                        PP(0, 2, PNT_BEZIER),
-                        PP(3, 2, PNT_LAST),
-
-                        '9',
-                        PP(1, 6, PNT_REGULAR),
-                        PP(6, 6, PNT_BEZIER),
-                        PP(6, 2, PNT_REGULAR),
-                        PP(6, 4, PNT_BEZIER),
-                        PP(3, 4, PNT_REGULAR),
-                        PP(0, 4, PNT_BEZIER),
-                        PP(0, 2, PNT_REGULAR),
-                        PP(0, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 3, PNT_LAST),
-
-                        ',',
-                        PP(3, 5, PNT_REGULAR),
-                        PP(2, 6, PNT_LAST),
-
-                        '.',
-                        PP(2, 6, PNT_REGULAR),
-                        PP(2, 6, PNT_LAST),
-
-                        '!',
-                        PP(2, 0, PNT_REGULAR),
-                        PP(2, 4, PNT_END),
-                        PP(2, 6, PNT_REGULAR),
-                        PP(2, 6, PNT_LAST),
-
-                        '?',
-                        PP(1, 1, PNT_REGULAR),
-                        PP(1, 0, PNT_BEZIER),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(6, 0, PNT_BEZIER),
-                        PP(6, 2, PNT_REGULAR),
-                        PP(6, 4, PNT_BEZIER),
-                        PP(3, 4, PNT_REGULAR),
-                        PP(3, 5, PNT_END),
-                        PP(3, 6, PNT_REGULAR),
-                        PP(3, 6, PNT_LAST),
-
-                        ':',
-                        PP(2, 1, PNT_REGULAR),
-                        PP(2, 1, PNT_END),
-                        PP(2, 5, PNT_REGULAR),
-                        PP(2, 5, PNT_LAST),
-
-                        '"',
-                        PP(2, 0, PNT_REGULAR),
-                        PP(2, 1, PNT_END),
-                        PP(3, 0, PNT_REGULAR),
-                        PP(3, 1, PNT_LAST),
-
-                        '\'',
-                        PP(3, 0, PNT_REGULAR),
-                        PP(2, 1, PNT_LAST),
-
-                        '+',
-                        PP(1, 3, PNT_REGULAR),
-                        PP(5, 3, PNT_END),
-                        PP(3, 1, PNT_REGULAR),
-                        PP(3, 5, PNT_LAST),
-
-                        '-',
-                        PP(1, 3, PNT_REGULAR),
-                        PP(5, 3, PNT_LAST),
-
-                        '*',
-                        PP(2, 2, PNT_REGULAR),
-                        PP(4, 4, PNT_END),
-                        PP(2, 4, PNT_REGULAR),
-                        PP(4, 2, PNT_LAST),
-
-                        '/',
-                        PP(6, 0, PNT_REGULAR),
-                        PP(0, 6, PNT_LAST),
-
-                        // No more glyphs...
-                        0};
-
 }  // namespace
 
-void glyph_renderer_t::init(const unsigned log2_width, const unsigned log2_height) {
+void glyph_renderer_t::init(const unsigned log2_width,
+                            const unsigned log2_height,
+                            const method_t method,
+                            const unsigned log2_string_width) {
   m_log2_width = log2_width;
   m_log2_height = log2_height;
   m_width = 1u << log2_width;
   m_height = 1u << log2_height;
-  const size_t mem_required = m_width * (m_height + 2);
-  m_pixels = reinterpret_cast<uint8_t*>(malloc(mem_required));
-  m_work_rows = m_pixels + (m_width * m_height);
+  m_method = method;
+  m_string_width = 0u;
+  m_strip = canvas_t();
+  m_canvas = &m_glyph;
+  if (!alloc_canvas(m_glyph, log2_width)) {
+    return;
+  }
+  if (log2_string_width >= log2_width && !alloc_canvas(m_strip, log2_string_width)) {
+    deinit();
+    return;
+  }
+
+  // The stroke radius (in pixels) for the COVERAGE method scales with the font grid.
+  const unsigned grid_size = 1u << std::min(log2_width - 3u, log2_height - 3u);
+  m_stroke_radius = 0.25f + 0.25f * static_cast<float>(grid_size);
 }
 
 void glyph_renderer_t::deinit() {
-  if (m_pixels != nullptr) {
-    free(m_pixels);
-    m_pixels = nullptr;
-  }
+  free_canvas(m_glyph);
+  free_canvas(m_strip);
 }
 
 void glyph_renderer_t::draw_char(const char c) {
-  if (m_pixels == nullptr) {
+  if (m_glyph.pixels == nullptr) {
     return;
   }
 
   // Start by clearing the pixel buffer.
-  memset(m_pixels, 0, m_width * m_height);
+  clear_canvas(m_glyph, m_width);
 
   // Find the glyph corresponding to the char c.
-  const uint8_t* ptr = &FONT[0];
-  while (*ptr != c && *ptr != 0) {
-    ++ptr;
-    for (; point_t(*ptr).kind != PNT_LAST; ++ptr)
-      ;
-    ++ptr;
-  }
-  if (*ptr == 0) {
+  const auto offset = FONT_INDEX.offset[static_cast<uint8_t>(c)];
+  if (offset == NO_GLYPH) {
     // We didn't have a glyph for the requested character, so don't do anything.
     return;
   }
-  ++ptr;
 
   // Draw the glyph.
-  draw_glyph(ptr);
+  draw_glyph(&FONT[offset], 0.0f);
+  if (m_method == COVERAGE) {
+    resolve_coverage(m_glyph, m_width);
+  }
 }
 
 void glyph_renderer_t::grow() {
-  if (m_pixels == nullptr) {
+  if (m_glyph.pixels == nullptr || m_method == COVERAGE) {
     return;
   }
+  grow_canvas(m_glyph, m_width);
+}
 
-  // TODO(m): Grow out to the edges too (x,y = 0,0 etc).
-  uint8_t* work_row = &m_work_rows[0];
-  uint8_t* prev_work_row = &m_work_rows[m_width];
-  const uint8_t* row1 = &m_pixels[0];
-  const uint8_t* row2 = &m_pixels[m_width];
-  const uint8_t* row3 = &m_pixels[2 * m_width];
-  for (unsigned y = 1u; y < m_height - 1u; ++y) {
-    // Read the first two columns of the 3x3 area.
-    uint32_t p11 = static_cast<uint32_t>(row1[0]);
-    uint32_t p12 = static_cast<uint32_t>(row1[1]);
-    uint32_t p21 = static_cast<uint32_t>(row2[0]);
-    uint32_t p22 = static_cast<uint32_t>(row2[1]);
-    uint32_t p31 = static_cast<uint32_t>(row3[0]);
-    uint32_t p32 = static_cast<uint32_t>(row3[1]);
-
-    for (unsigned x = 1u; x < m_width - 1u; ++x) {
-      // Read the last column of the 3x3 area.
-      uint32_t p13 = static_cast<uint32_t>(row1[x + 1]);
-      uint32_t p23 = static_cast<uint32_t>(row2[x + 1]);
-      uint32_t p33 = static_cast<uint32_t>(row3[x + 1]);
-
-      // 3x3 Gaussian kernel.
-      const uint32_t d0 = p22;
-      const uint32_t d1 = p12 + p21 + p23 + p32;
-      const uint32_t d2 = p11 + p13 + p31 + p33;
-      work_row[x] = static_cast<uint8_t>(12 * (d0 >> 6) + 8 * (d1 >> 6) + 5 * (d2 >> 6));
-
-      // Shift all pixels to the left.
-      p11 = p12;
-      p12 = p13;
-      p21 = p22;
-      p22 = p23;
-      p31 = p32;
-      p32 = p33;
-    }
+unsigned glyph_renderer_t::draw_string(const char* str,
+                                       const kerning_pair_t* kerning,
+                                       const unsigned num_kerning_pairs) {
+  m_string_width = 0u;
+  if (m_strip.pixels == nullptr) {
+    return 0u;
+  }
 
-    if (y > 1u) {
-      for (unsigned x = 1; x < m_width - 1; ++x) {
-        m_pixels[(y - 1) * m_width + x] = addsu(m_pixels[(y - 1) * m_width + x], prev_work_row[x]);
+  // Lay out the glyphs (stop at the first glyph that does not fit in the strip).
+  const unsigned grid_unit = 1u << (m_log2_width - 3u);
+  unsigned x_pos[MAX_STRING_LENGTH];
+  unsigned num_glyphs = 0u;
+  unsigned x = 0u;
+  unsigned paint_width = 0u;
+  for (const char* ptr = str; *ptr != 0 && num_glyphs < MAX_STRING_LENGTH; ++ptr) {
+    const auto c = static_cast<uint8_t>(*ptr);
+    if (ptr != str) {
+      for (unsigned k = 0u; k < num_kerning_pairs; ++k) {
+        if (kerning[k].first == ptr[-1] && kerning[k].second == *ptr) {
+          const int adjust = kerning[k].adjust * static_cast<int>(grid_unit);
+          x = static_cast<unsigned>(std::max(static_cast<int>(x) + adjust, 0));
+          break;
+        }
       }
     }
+    if (x + m_width > m_strip.width) {
+      break;
+    }
+    x_pos[num_glyphs++] = x;
+    if (FONT_INDEX.offset[c] != NO_GLYPH) {
+      paint_width = x + m_width;
+    }
+    x += FONT_INDEX.advance[c] * grid_unit;
+  }
 
-    std::swap(prev_work_row, work_row);
-    row1 = row2;
-    row2 = row3;
-    row3 += m_width;
+  // Draw all the glyphs into the strip, and do the final coverage pass once for the entire strip.
+  // The strip is only processed up to the last glyph, rounded up to a whole number of bytes for
+  // all paint formats.
+  paint_width = std::min((paint_width + 7u) & ~7u, m_strip.width);
+  clear_canvas(m_strip, paint_width);
+  m_canvas = &m_strip;
+  for (unsigned k = 0u; k < num_glyphs; ++k) {
+    const auto offset = FONT_INDEX.offset[static_cast<uint8_t>(str[k])];
+    if (offset != NO_GLYPH) {
+      draw_glyph(&FONT[offset], static_cast<float>(x_pos[k]));
+    }
+  }
+  m_canvas = &m_glyph;
+  if (paint_width > 0u) {
+    if (m_method == COVERAGE) {
+      resolve_coverage(m_strip, paint_width);
+    } else {
+      grow_canvas(m_strip, paint_width);
+    }
   }
+
+  m_string_width = paint_width;
+  return std::min(x, m_strip.width);
 }
 
-#ifndef __MRISC32__
 void glyph_renderer_t::paint_8bpp(uint8_t* pix, const unsigned stride) {
-  if (m_pixels == nullptr) {
-    return;
+  paint_8bpp(m_glyph.pixels, pix, stride);
+}
+
+void glyph_renderer_t::paint_4bpp(uint8_t* pix, const unsigned stride) {
+  paint_4bpp(m_glyph.pixels, pix, stride);
+}
+
+void glyph_renderer_t::paint_2bpp(uint8_t* pix, const unsigned stride) {
+  paint_2bpp(m_glyph.pixels, pix, stride);
+}
+
+void glyph_renderer_t::paint_1bpp(uint8_t* pix, const unsigned stride) {
+  paint_1bpp(m_glyph.pixels, pix, stride);
+}
+
+void glyph_renderer_t::paint_8bpp(const uint8_t* coverage,
+                                  uint8_t* pix,
+                                  const unsigned stride) const {
+  if (coverage != nullptr) {
+    paint_rows(coverage, m_width, m_width, m_height, pix, stride, 8u);
   }
+}
+
+void glyph_renderer_t::paint_4bpp(const uint8_t* coverage,
+                                  uint8_t* pix,
+                                  const unsigned stride) const {
+  if (coverage != nullptr) {
+    paint_rows(coverage, m_width, m_width, m_height, pix, stride, 4u);
+  }
+}
+
+void glyph_renderer_t::paint_2bpp(const uint8_t* coverage,
+                                  uint8_t* pix,
+                                  const unsigned stride) const {
+  if (coverage != nullptr) {
+    paint_rows(coverage, m_width, m_width, m_height, pix, stride, 2u);
+  }
+}
+
+void glyph_renderer_t::paint_1bpp(const uint8_t* coverage,
+                                  uint8_t* pix,
+                                  const unsigned stride) const {
+  if (coverage != nullptr) {
+    paint_rows(coverage, m_width, m_width, m_height, pix, stride, 1u);
+  }
+}
 
-  // TODO(m): Optimize this loop.
-  const uint8_t* src = m_pixels;
-  uint8_t* dst = pix;
-  for (unsigned y = 0; y < m_height; ++y) {
-    for (unsigned x = 0; x < m_width; ++x) {
-      *dst++ = *src++;
+void glyph_renderer_t::paint_string_8bpp(uint8_t* pix, const unsigned stride) const {
+  paint_rows(m_strip.pixels, m_strip.width, m_string_width, m_height, pix, stride, 8u);
+}
+
+void glyph_renderer_t::paint_string_4bpp(uint8_t* pix, const unsigned stride) const {
+  paint_rows(m_strip.pixels, m_strip.width, m_string_width, m_height, pix, stride, 4u);
+}
+
+void glyph_renderer_t::paint_string_2bpp(uint8_t* pix, const unsigned stride) const {
+  paint_rows(m_strip.pixels, m_strip.width, m_string_width, m_height, pix, stride, 2u);
+}
+
+void glyph_renderer_t::paint_string_1bpp(uint8_t* pix, const unsigned stride) const {
+  paint_rows(m_strip.pixels, m_strip.width, m_string_width, m_height, pix, stride, 1u);
+}
+
+bool glyph_renderer_t::alloc_canvas(canvas_t& canvas, const unsigned log2_width) {
+  canvas.log2_width = log2_width;
+  canvas.width = 1u << log2_width;
+  const size_t mem_required = canvas.width * (m_height + 2);
+  canvas.pixels = reinterpret_cast<uint8_t*>(malloc(mem_required));
+  if (canvas.pixels == nullptr) {
+    return false;
+  }
+  canvas.work_rows = canvas.pixels + (canvas.width * m_height);
+
+  // The coverage accumulation buffer is stored column by column (see accumulate_edge()), with two
+  // extra columns for edges that touch the right border, and one column for the running sums.
+  canvas.accum = nullptr;
+  if (m_method == COVERAGE) {
+    canvas.accum = reinterpret_cast<float*>(malloc(sizeof(float) * (canvas.width + 3) * m_height));
+    if (canvas.accum == nullptr) {
+      free_canvas(canvas);
+      return false;
     }
-    dst += stride - m_width;
   }
+  return true;
 }
-#endif
 
-void glyph_renderer_t::paint_2bpp(uint8_t* pix, const unsigned stride) {
-  if (m_pixels == nullptr) {
-    return;
+void glyph_renderer_t::free_canvas(canvas_t& canvas) {
+  if (canvas.pixels != nullptr) {
+    free(canvas.pixels);
+    canvas.pixels = nullptr;
+  }
+  if (canvas.accum != nullptr) {
+    free(canvas.accum);
+    canvas.accum = nullptr;
+  }
+}
+
+void glyph_renderer_t::clear_canvas(canvas_t& canvas, const unsigned width) {
+  if (width == canvas.width) {
+    memset(canvas.pixels, 0, canvas.width * m_height);
+  } else {
+    for (unsigned y = 0; y < m_height; ++y) {
+      memset(&canvas.pixels[y * canvas.width], 0, width);
+    }
+  }
+  if (m_method == COVERAGE) {
+    // Note: Edges that are clamped to the right border touch the two columns following it.
+    const unsigned num_cols = std::min(width + 2u, canvas.width + 2u);
+    memset(canvas.accum, 0, sizeof(float) * num_cols * m_height);
   }
+}
 
-  // TODO(m): Optimize this loop.
-  const uint8_t* src = m_pixels;
-  uint8_t* dst = pix;
-  for (unsigned y = 0; y < m_height; ++y) {
-    for (unsigned x = 0; x < m_width; x += 4) {
-      const uint32_t c1 = static_cast<uint32_t>(*src++);
-      const uint32_t c2 = static_cast<uint32_t>(*src++);
-      const uint32_t c3 = static_cast<uint32_t>(*src++);
-      const uint32_t c4 = static_cast<uint32_t>(*src++);
-      *dst++ = static_cast<uint8_t>((c4 & 0xc0u) | ((c3 & 0xc0u) >> 2) | ((c2 & 0xc0u) >> 4) |
-                                    (c1 >> 6));
+void glyph_renderer_t::grow_canvas(canvas_t& canvas, const unsigned width) {
+  // TODO(m): Grow out to the edges too (x,y = 0,0 etc).
+  // Note: The result for each row is added to the pixels one row later, when the row is no longer
+  // needed as input. The border pixels of the work rows are zero, so that whole rows can be added.
+  uint8_t* work_row = &canvas.work_rows[0];
+  uint8_t* prev_work_row = &canvas.work_rows[canvas.width];
+  work_row[0] = work_row[width - 1u] = 0u;
+  prev_work_row[0] = prev_work_row[width - 1u] = 0u;
+  const uint8_t* row1 = &canvas.pixels[0];
+  const uint8_t* row2 = &canvas.pixels[canvas.width];
+  const uint8_t* row3 = &canvas.pixels[2 * canvas.width];
+  for (unsigned y = 1u; y < m_height - 1u; ++y) {
+    blur_row(work_row, row1, row2, row3, width);
+    if (y > 1u) {
+      addsu_row(&canvas.pixels[(y - 1) * canvas.width], prev_work_row, width);
     }
-    dst += stride - (m_width / 4);
+
+    std::swap(prev_work_row, work_row);
+    row1 = row2;
+    row2 = row3;
+    row3 += canvas.width;
   }
 }
 
-void glyph_renderer_t::draw_glyph(const uint8_t* points) {
+void glyph_renderer_t::draw_glyph(const uint8_t* points, const float origin_x) {
   // Draw the lines and curves, 1 pixel wide.
   const uint32_t shift_x = m_log2_width - 3u;   // width / 8
   const uint32_t shift_y = m_log2_height - 3u;  // height / 8
@@ -639,10 +582,10 @@ void glyph_renderer_t::draw_glyph(const uint8_t* points) {
     const point_t p2 = point_t(*points++, shift_x, shift_y);
     if (p2.kind == PNT_BEZIER) {
       const point_t p3 = point_t(*points++, shift_x, shift_y);
-      draw_bez3(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y);
+      draw_bez3(origin_x + p1.x, p1.y, origin_x + p2.x, p2.y, origin_x + p3.x, p3.y);
       p1 = p3;
     } else {
-      draw_line(p1.x, p1.y, p2.x, p2.y);
+      draw_line(origin_x + p1.x, p1.y, origin_x + p2.x, p2.y);
       p1 = p2;
     }
     if (p1.kind == PNT_END) {
@@ -652,6 +595,11 @@ void glyph_renderer_t::draw_glyph(const uint8_t* points) {
 }
 
 void glyph_renderer_t::draw_line(const float x0, const float y0, const float x1, const float y1) {
+  if (m_method == COVERAGE) {
+    draw_stroke(x0, y0, x1, y1);
+    return;
+  }
+
   const float dx = x1 - x0;
   const float dy = y1 - y0;
 #ifdef __MRISC32__
@@ -682,16 +630,16 @@ void glyph_renderer_t::draw_line(const float x0, const float y0, const float x1,
       : "+r"(num_steps),    // %0
         "+r"(x),            // %1
         "+r"(y)             // %2
-      : "r"(m_pixels),      // %3
-        "r"(m_log2_width),  // %4
-        "r"(step_x),        // %5
-        "r"(step_y)         // %6
+      : "r"(m_canvas->pixels),      // %3
+        "r"(m_canvas->log2_width),  // %4
+        "r"(step_x),                // %5
+        "r"(step_y)                 // %6
       : "r6", "r7", "r8");
 #else
   do {
     const int ix = round_to_int(x);
     const int iy = round_to_int(y);
-    m_pixels[(iy << m_log2_width) + ix] = 255;
+    m_canvas->pixels[(iy << m_canvas->log2_width) + ix] = 255;
     x += step_x;
     y += step_y;
     --num_steps;
@@ -705,19 +653,312 @@ void glyph_renderer_t::draw_bez3(const float x0,
                                  const float y1,
                                  const float x2,
                                  const float y2) {
-  const int num_steps = 10;
-  const float step_size = 1.0f / static_cast<float>(num_steps);
+  // The largest distance between the curve and a chord of n uniform steps is |p0 - 2p1 + p2| / 4n^2
+  // (the coordinates are already scaled to pixels), so pick the smallest n that keeps the distance
+  // below MAX_ERROR pixels.
+  constexpr float MAX_ERROR = 0.25f;
+  constexpr int MAX_STEPS = 32;
+  const float ax = x0 - 2.0f * x1 + x2;
+  const float ay = y0 - 2.0f * y1 + y2;
+  const float dd = std::sqrt(sqr(ax) + sqr(ay));
+  const int num_steps =
+      std::min(static_cast<int>(std::ceil(std::sqrt(dd * (1.0f / (4.0f * MAX_ERROR))))), MAX_STEPS);
+  if (num_steps <= 1) {
+    draw_line(x0, y0, x2, y2);
+    return;
+  }
+
+  // Step along the curve with forward differencing, in 16.16 fixed point:
+  //   p(t + h) - p(t) = 2h(p1 - p0) + h^2 a + 2h^2 a t
+  const float h = 1.0f / static_cast<float>(num_steps);
+  const float h2 = h * h;
+  int32_t px = static_cast<int32_t>(x0 * 65536.0f);
+  int32_t py = static_cast<int32_t>(y0 * 65536.0f);
+  int32_t dx = static_cast<int32_t>((2.0f * h * (x1 - x0) + h2 * ax) * 65536.0f);
+  int32_t dy = static_cast<int32_t>((2.0f * h * (y1 - y0) + h2 * ay) * 65536.0f);
+  const int32_t ddx = static_cast<int32_t>(2.0f * h2 * ax * 65536.0f);
+  const int32_t ddy = static_cast<int32_t>(2.0f * h2 * ay * 65536.0f);
   float last_x = x0;
   float last_y = y0;
-  float t = step_size;
-  for (int i = num_steps; i != 0; --i) {
-    const float x = sqr(1.0f - t) * x0 + (2.0f * t * (1.0f - t)) * x1 + sqr(t) * x2;
-    const float y = sqr(1.0f - t) * y0 + (2.0f * t * (1.0f - t)) * y1 + sqr(t) * y2;
+  for (int i = num_steps - 1; i != 0; --i) {
+    px += dx;
+    py += dy;
+    dx += ddx;
+    dy += ddy;
+    const float x = static_cast<float>(px) * (1.0f / 65536.0f);
+    const float y = static_cast<float>(py) * (1.0f / 65536.0f);
     draw_line(last_x, last_y, x, y);
     last_x = x;
     last_y = y;
-    t += step_size;
   }
+
+  // End exactly at the end point.
+  draw_line(last_x, last_y, x2, y2);
+}
+
+void glyph_renderer_t::draw_stroke(const float x0, const float y0, const float x1, const float y1) {
+  // The stroke is a rectangle around the line, that extends one stroke radius past the end points
+  // (so that joints between strokes are covered). Point coordinates are at pixel centers.
+  float dx = x1 - x0;
+  float dy = y1 - y0;
+  const float len = std::sqrt(dx * dx + dy * dy);
+  if (len > 0.0f) {
+    const float s = m_stroke_radius / len;
+    dx *= s;
+    dy *= s;
+  } else {
+    dx = m_stroke_radius;
+  }
+  const float ax = x0 + 0.5f - dx - dy;
+  const float ay = y0 + 0.5f - dy + dx;
+  const float bx = x1 + 0.5f + dx - dy;
+  const float by = y1 + 0.5f + dy + dx;
+  const float cx = x1 + 0.5f + dx + dy;
+  const float cy = y1 + 0.5f + dy - dx;
+  const float ex = x0 + 0.5f - dx + dy;
+  const float ey = y0 + 0.5f - dy - dx;
+  accumulate_edge(ax, ay, bx, by);
+  accumulate_edge(bx, by, cx, cy);
+  accumulate_edge(cx, cy, ex, ey);
+  accumulate_edge(ex, ey, ax, ay);
+}
+
+void glyph_renderer_t::accumulate_edge(float x0, float y0, float x1, float y1) {
+  // This is the signed area accumulation of font-rs: Each edge adds (or subtracts, depending on its
+  // direction) the area to its right to the pixels that it passes through, and the area that is
+  // left of the next pixel boundary to the following pixel. The prefix sum of a row then gives the
+  // coverage of each pixel (see resolve_coverage()).
+  //
+  // The accumulation buffer is stored column by column, i.e. the entry for pixel (x, y) is at
+  // accum[x * m_height + y].
+  if (y0 == y1) {
+    return;
+  }
+  float dir = 1.0f;
+  if (y0 > y1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+    dir = -1.0f;
+  }
+
+  const float dxdy = (x1 - x0) / (y1 - y0);
+  float x = x0;
+  if (y0 < 0.0f) {
+    x -= y0 * dxdy;
+  }
+  const int row_start = std::max(static_cast<int>(std::floor(y0)), 0);
+  const int row_end = std::min(static_cast<int>(std::ceil(y1)), static_cast<int>(m_height));
+  const unsigned h = m_height;
+  const float max_x = static_cast<float>(m_canvas->width);
+  for (int y = row_start; y < row_end; ++y) {
+    float* acc = &m_canvas->accum[y];
+    const float fy = static_cast<float>(y);
+    const float row_dy = std::min(fy + 1.0f, y1) - std::max(fy, y0);
+    const float x_next = x + dxdy * row_dy;
+    const float d = row_dy * dir;
+
+    // Parts of the edge that are outside of the left and right borders are moved to the borders,
+    // which keeps the sum of the row intact.
+    const float xc = std::min(std::max(x, 0.0f), max_x);
+    const float xc_next = std::min(std::max(x_next, 0.0f), max_x);
+    x = x_next;
+
+    const float xa = std::min(xc, xc_next);
+    const float xb = std::max(xc, xc_next);
+    const float xa_floor = std::floor(xa);
+    const int xa_i = static_cast<int>(xa_floor);
+    const float xb_ceil = std::ceil(xb);
+    const int xb_i = static_cast<int>(xb_ceil);
+    if (xb_i <= xa_i + 1) {
+      // The edge is within a single pixel in this row.
+      const float x_mid = 0.5f * (xc + xc_next) - xa_floor;
+      acc[xa_i * h] += d - d * x_mid;
+      acc[(xa_i + 1) * h] += d * x_mid;
+    } else {
+      // The edge spans several pixels in this row.
+      const float s = 1.0f / (xb - xa);
+      const float xa_frac = xa - xa_floor;
+      const float a0 = 0.5f * s * (1.0f - xa_frac) * (1.0f - xa_frac);
+      const float xb_frac = xb - xb_ceil + 1.0f;
+      const float am = 0.5f * s * xb_frac * xb_frac;
+      acc[xa_i * h] += d * a0;
+      if (xb_i == xa_i + 2) {
+        acc[(xa_i + 1) * h] += d * (1.0f - a0 - am);
+      } else {
+        const float a1 = s * (1.5f - xa_frac);
+        acc[(xa_i + 1) * h] += d * (a1 - a0);
+        for (int xi = xa_i + 2; xi < xb_i - 1; ++xi) {
+          acc[xi * h] += d * s;
+        }
+        const float a2 = a1 + static_cast<float>(xb_i - xa_i - 3) * s;
+        acc[(xb_i - 1) * h] += d * (1.0f - a2 - am);
+      }
+      acc[xb_i * h] += d * am;
+    }
+  }
+}
+
+void glyph_renderer_t::resolve_coverage(canvas_t& canvas, const unsigned width) {
+  // Calculate the prefix sum of each row, and convert the absolute value of the sum to an 8-bit
+  // coverage value. Since the accumulation buffer is stored column by column, all rows are
+  // processed in parallel (one column at a time).
+  float* sums = &canvas.accum[(canvas.width + 2) * m_height];
+  memset(sums, 0, sizeof(float) * m_height);
+  const float* col = canvas.accum;
+  for (unsigned x = 0; x < width; ++x) {
+    uint8_t* dst = &canvas.pixels[x];
+#if defined(__MRISC32_VECTOR_OPS__) && defined(__MRISC32_HARD_FLOAT__)
+    float* sum = sums;
+    unsigned count = m_height;
+    unsigned tmp;
+    __asm volatile(
+        "getsr   vl, #0x10\n"
+
+        "1:\n\t"
+        "min     vl, vl, %[count]\n\t"
+        "sub     %[count], %[count], vl\n\t"
+        "ldw     v1, %[col], #4\n\t"
+        "ldw     v2, %[sum], #4\n\t"
+        "fadd    v2, v2, v1\n\t"
+        "stw     v2, %[sum], #4\n\t"
+        "ldea    %[col], %[col], vl*4\n\t"
+        "ldea    %[sum], %[sum], vl*4\n\t"
+
+        // |sum| clamped to [0, 1], scaled to [0, 255].
+        "and     v2, v2, %[abs_mask]\n\t"
+        "fmin    v2, v2, %[one]\n\t"
+        "fmul    v2, v2, %[scale]\n\t"
+        "ftoir   v2, v2, z\n\t"
+        "stb     v2, %[dst], %[stride]\n\t"
+        "mul     %[tmp], %[stride], vl\n\t"
+        "add     %[dst], %[dst], %[tmp]\n\t"
+        "bgt     %[count], 1b"
+        : [ col ] "+r"(col),
+          [ sum ] "+r"(sum),
+          [ dst ] "+r"(dst),
+          [ count ] "+r"(count),
+          [ tmp ] "=&r"(tmp)
+        : [ abs_mask ] "r"(0x7fffffffu),
+          [ one ] "r"(1.0f),
+          [ scale ] "r"(255.0f),
+          [ stride ] "r"(canvas.width)
+        : "vl", "v1", "v2", "memory");
+#else
+    for (unsigned y = 0; y < m_height; ++y) {
+      sums[y] += col[y];
+      const float coverage = std::min(std::fabs(sums[y]), 1.0f);
+      dst[y * canvas.width] = static_cast<uint8_t>(round_to_int(coverage * 255.0f));
+    }
+    col += m_height;
+#endif
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Glyph cache.
+//--------------------------------------------------------------------------------------------------
+
+bool glyph_cache_t::init(const size_t budget, const bool use_vram) {
+  m_memory = reinterpret_cast<uint8_t*>(use_vram ? vmem_alloc(budget) : malloc(budget));
+  if (m_memory == nullptr) {
+    return false;
+  }
+  m_budget = budget;
+  m_use_vram = use_vram;
+  clear();
+  return true;
+}
+
+void glyph_cache_t::deinit() {
+  if (m_memory != nullptr) {
+    if (m_use_vram) {
+      vmem_free(m_memory);
+    } else {
+      free(m_memory);
+    }
+    m_memory = nullptr;
+  }
+  m_budget = 0;
+  m_num_entries = 0;
+}
+
+void glyph_cache_t::clear() {
+  m_num_entries = 0;
+  m_clock = 0;
+}
+
+const uint8_t* glyph_cache_t::get(glyph_renderer_t& renderer, const char c) {
+  const uint32_t key = static_cast<uint32_t>(static_cast<uint8_t>(c)) |
+                       (renderer.log2_width() << 8) | (renderer.log2_height() << 16) |
+                       (static_cast<uint32_t>(renderer.method()) << 24);
+  ++m_clock;
+
+  // Cache hit?
+  for (unsigned i = 0; i < m_num_entries; ++i) {
+    auto& entry = m_entries[i];
+    if (entry.key == key) {
+      entry.last_use = m_clock;
+      return &m_memory[entry.offset];
+    }
+  }
+
+  // Cache miss: Render the glyph and store the result in a new entry.
+  const uint32_t size = 1u << (renderer.log2_width() + renderer.log2_height());
+  if (m_memory == nullptr || size > m_budget || renderer.pixels() == nullptr) {
+    return nullptr;
+  }
+  const int idx = allocate(size);
+  auto& entry = m_entries[idx];
+  entry.key = key;
+  entry.last_use = m_clock;
+  renderer.draw_char(c);
+  renderer.grow();
+  memcpy(&m_memory[entry.offset], renderer.pixels(), size);
+  return &m_memory[entry.offset];
+}
+
+int glyph_cache_t::allocate(const uint32_t size) {
+  while (true) {
+    // Find the first gap between the entries (which are sorted by offset) that is large enough.
+    if (m_num_entries < MAX_ENTRIES) {
+      uint32_t gap_start = 0;
+      for (unsigned i = 0; i <= m_num_entries; ++i) {
+        const uint32_t gap_end =
+            (i < m_num_entries) ? m_entries[i].offset : static_cast<uint32_t>(m_budget);
+        if (gap_end - gap_start >= size) {
+          // Insert a new entry at position i.
+          for (unsigned k = m_num_entries; k > i; --k) {
+            m_entries[k] = m_entries[k - 1];
+          }
+          ++m_num_entries;
+          m_entries[i].offset = gap_start;
+          m_entries[i].size = size;
+          return static_cast<int>(i);
+        }
+        if (i < m_num_entries) {
+          gap_start = m_entries[i].offset + m_entries[i].size;
+        }
+      }
+    }
+
+    // No room: Evict the least recently used entry and try again (this always terminates, since
+    // the size fits in the empty cache).
+    evict_lru();
+  }
+}
+
+void glyph_cache_t::evict_lru() {
+  unsigned lru = 0;
+  for (unsigned i = 1; i < m_num_entries; ++i) {
+    // Note: The difference handles wrap-around of the clock.
+    if ((m_clock - m_entries[i].last_use) > (m_clock - m_entries[lru].last_use)) {
+      lru = i;
+    }
+  }
+  for (unsigned k = lru + 1; k < m_num_entries; ++k) {
+    m_entries[k - 1] = m_entries[k];
+  }
+  --m_num_entries;
 }
 
 }  // namespace mc1
@@ -26,6 +26,8 @@
 
 #include <mr32intrin.h>
 
+#include <string.h>
+
 //-- PRIVATE ---------------------------------------------------------------------------------------
 
 // Define to enable safety checks (increases code size).
@@ -55,15 +57,17 @@ static inline uint32_t _LZG_Min(const uint32_t a, const uint32_t b) {
 }
 
 #ifdef CONF_DO_CHECKS
-// Calculate the checksum.
-static uint32_t _LZG_CalcChecksum(const uint8_t* data, uint32_t size) {
-  uint16_t a = 1, b = 0;
-  const uint8_t* end = ((const uint8_t*)data) + size;
+// Update the running checksum.
+static void _LZG_UpdateChecksum(lzg_stream_t* stream, const uint8_t* data, uint32_t size) {
+  uint16_t a = (uint16_t)stream->checksum_a;
+  uint16_t b = (uint16_t)stream->checksum_b;
+  const uint8_t* end = data + size;
   while (data != end) {
     a += *data++;
     b += a;
   }
-  return (((uint32_t)b) << 16) | a;
+  stream->checksum_a = a;
+  stream->checksum_b = b;
 }
 #endif  // CONF_DO_CHECKS
 
@@ -72,147 +76,334 @@ static const uint8_t _LZG_LENGTH_DECODE_LUT[32] = {2,  3,  4,  5,  6,  7,  8,  9
                                                    13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
                                                    24, 25, 26, 27, 28, 29, 35, 48, 72, 128};
 
-//-- PUBLIC ----------------------------------------------------------------------------------------
+// Minimum number of bytes for using the vector copy loop.
+#define LZG_VECTOR_COPY_MIN 16u
 
-uint32_t LZG_Decode(const uint8_t* in,
-                    const uint32_t insize,
-                    uint8_t* out,
-                    const uint32_t outsize) {
-#ifdef CONF_DO_CHECKS
-  // Check magic ID.
-  if ((insize < LZG_HEADER_SIZE) || (in[0] != 'L') || (in[1] != 'Z') || (in[2] != 'G')) {
-    return 0;
+// Minimum number of bytes for using memset() for a run of a single byte.
+#define LZG_MEMSET_MIN 16u
+
+// Copy n bytes forwards, word or vector wise. The source range must not overlap the destination
+// range, unless the source is ahead of the destination.
+static inline void _LZG_CopyForward(uint8_t* dst, const uint8_t* src, uint32_t n) {
+#ifdef __MRISC32_VECTOR_OPS__
+  if (n >= LZG_VECTOR_COPY_MIN) {
+    __asm volatile(
+        "getsr   vl, #0x10\n"
+        "1:\n\t"
+        "min     vl, vl, %[n]\n\t"
+        "sub     %[n], %[n], vl\n\t"
+        "ldub    v1, %[src], #1\n\t"
+        "stb     v1, %[dst], #1\n\t"
+        "add     %[src], %[src], vl\n\t"
+        "add     %[dst], %[dst], vl\n\t"
+        "bgt     %[n], 1b"
+        : [ dst ] "+r"(dst), [ src ] "+r"(src), [ n ] "+r"(n)
+        :
+        : "vl", "v1", "memory");
+    return;
   }
-#endif  // CONF_DO_CHECKS
+#endif
+  if (n >= 8u && ((((uintptr_t)dst) | ((uintptr_t)src)) & 3u) == 0u) {
+    uint32_t* dst_words = (uint32_t*)dst;
+    const uint32_t* src_words = (const uint32_t*)src;
+    for (uint32_t i = n >> 2; i > 0u; --i) {
+      *dst_words++ = *src_words++;
+    }
+    dst = (uint8_t*)dst_words;
+    src = (const uint8_t*)src_words;
+    n &= 3u;
+  }
+  for (uint32_t i = 0u; i < n; ++i) {
+    *dst++ = *src++;
+  }
+}
 
-  // Get header data.
-  const uint32_t decoded_size = _LZG_GetUINT32(in, 3);
-#ifdef CONF_DO_CHECKS
-  const uint32_t encoded_size = _LZG_GetUINT32(in, 7);
-  const uint32_t checksum = _LZG_GetUINT32(in, 11);
-#endif  // CONF_DO_CHECKS
+// Copy a match of length bytes from offset bytes back in the output, and return the new output
+// position.
+static inline uint8_t* _LZG_CopyMatch(uint8_t* dst, const uint32_t offset, uint32_t length) {
+  const uint8_t* copy = dst - offset;
 
-#ifdef CONF_DO_CHECKS
-  // Check sizes.
-  if ((outsize < decoded_size) || (encoded_size != (insize - LZG_HEADER_SIZE))) {
-    return 0;
+  // A run of a single byte (RLE).
+  if (offset == 1u) {
+    if (length >= LZG_MEMSET_MIN) {
+      memset(dst, (int)*copy, length);
+      return dst + length;
+    }
+    const uint8_t value = *copy;
+    for (uint32_t i = 0u; i < length; ++i) {
+      *dst++ = value;
+    }
+    return dst;
   }
 
-  // Check checksum.
-  if (_LZG_CalcChecksum(&in[LZG_HEADER_SIZE], encoded_size) != checksum) {
-    return 0;
+  // Copy the match in parts that do not overlap their sources. When the match overlaps itself
+  // (i.e. it repeats a short pattern), the copied data repeats with twice the distance, so the
+  // distance (and the size of the next part) is doubled after each part.
+  uint32_t dist = offset;
+  while (length > dist) {
+    _LZG_CopyForward(dst, copy, dist);
+    dst += dist;
+    length -= dist;
+    dist += dist;
   }
-#endif  // CONF_DO_CHECKS
+  _LZG_CopyForward(dst, copy, length);
+  return dst + length;
+}
 
-  // Initialize the byte streams.
-  const uint8_t* src = ((const uint8_t*)in) + LZG_HEADER_SIZE;
-  const uint8_t* in_end = ((const uint8_t*)in) + insize;
-  uint8_t* dst = out;
-  const uint8_t* out_end = out + outsize;
+// Get the number of bytes of the token that starts at src (given that avail > 0 bytes are
+// available). If avail is too small to tell, a number larger than avail is returned.
+static uint32_t _LZG_TokenSize(const uint8_t* src, const uint32_t avail, const uint8_t* markers) {
+  const uint8_t symbol = src[0];
+  if ((symbol != markers[0]) && (symbol != markers[1]) && (symbol != markers[2]) &&
+      (symbol != markers[3])) {
+    return 1;
+  }
+  if (avail < 2 || src[1] == 0) {
+    return 2;
+  }
+  return (symbol == markers[0]) ? 4 : (symbol == markers[1]) ? 3 : 2;
+}
 
-  // Check which method to use.
-  const uint32_t method = (uint32_t)in[15];
-  if (method == LZG_METHOD_LZG1) {
+// Decode all the complete tokens in [src, in_end), and return the start of the first incomplete
+// token (or in_end).
+static const uint8_t* _LZG_DecodeTokens(lzg_stream_t* stream,
+                                        const uint8_t* src,
+                                        const uint8_t* in_end) {
+  const uint8_t* markers = &stream->prologue[LZG_HEADER_SIZE];
+  const uint32_t m1 = (uint32_t)markers[0];
+  const uint32_t m2 = (uint32_t)markers[1];
+  const uint32_t m3 = (uint32_t)markers[2];
+  const uint32_t m4 = (uint32_t)markers[3];
+  uint8_t* dst = stream->dst;
 #ifdef CONF_DO_CHECKS
-    if (!((src + 4) <= in_end)) {
-      return 0;
-    }
+  const uint8_t* out = stream->out;
+  const uint8_t* out_end = stream->out_end;
 #endif
-    const uint32_t m1 = (uint32_t)*src++;
-    const uint32_t m2 = (uint32_t)*src++;
-    const uint32_t m3 = (uint32_t)*src++;
-    const uint32_t m4 = (uint32_t)*src++;
 
-    // Main decompression loop.
-    while (src < in_end) {
-      const uint8_t symbol = *src++;
+  // Main decompression loop.
+  while (src < in_end) {
+    // All tokens are at most four bytes, so only the last few tokens need a size check.
+    const uint32_t avail = (uint32_t)(in_end - src);
+    if (avail < 4u && _LZG_TokenSize(src, avail, markers) > avail) {
+      break;
+    }
 
-      if ((symbol != m1) && (symbol != m2) && (symbol != m3) && (symbol != m4)) {
-        // Literal copy.
-#ifdef CONF_DO_CHECKS
-        if (!(dst < out_end)) {
-          return 0;
+    const uint8_t symbol = *src++;
+
+    if ((symbol != m1) && (symbol != m2) && (symbol != m3) && (symbol != m4)) {
+      // Literal copy. All bytes up to the next marker symbol are literals, and are copied at once.
+      const uint8_t* literals = src - 1;
+      while (src < in_end) {
+        const uint32_t c = (uint32_t)*src;
+        if ((c == m1) || (c == m2) || (c == m3) || (c == m4)) {
+          break;
         }
+        ++src;
+      }
+      const uint32_t count = (uint32_t)(src - literals);
+#ifdef CONF_DO_CHECKS
+      if (!((dst + count) <= out_end)) {
+        stream->error = 1;
+        break;
+      }
 #endif
+      if (count == 1u) {
         *dst++ = symbol;
       } else {
-        // Decode offset / length parameters.
+        _LZG_CopyForward(dst, literals, count);
+        dst += count;
+      }
+    } else {
+      // Decode offset / length parameters.
+      const uint32_t b = (uint32_t)*src++;
+      if (b != 0) {
+        uint32_t length, offset;
+        if (symbol == m1) {
+          // Distant copy.
+          length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
+          const uint32_t b2 = (uint32_t)*src++;
+          offset = ((b & 0xe0) << 11) | (b2 << 8) | (*src++);
+          offset += 2056;
+        } else if (symbol == m2) {
+          // Medium copy.
+          length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
+          const uint32_t b2 = (uint32_t)*src++;
+          offset = ((b & 0xe0) << 3) | b2;
+          offset += 8;
+        } else if (symbol == m3) {
+          // Short copy.
+          length = (b >> 6) + 3;
+          offset = (b & 0x3f) + 8;
+        } else {
+          // Near copy (including RLE).
+          length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
+          offset = (b >> 5) + 1;
+        }
+
+        // Copy the corresponding data from the history window.
 #ifdef CONF_DO_CHECKS
-        if (!(src < in_end)) {
-          return 0;
+        if (!(((uint32_t)(dst - out) >= offset) && ((dst + length) <= out_end))) {
+          stream->error = 1;
+          break;
         }
 #endif
-        const uint32_t b = (uint32_t)*src++;
-        if (b != 0) {
-          uint32_t length, offset;
-          if (symbol == m1) {
-            // Distant copy.
+        dst = _LZG_CopyMatch(dst, offset, length);
+      } else {
+        // Literal copy (single occurance of a marker symbol).
 #ifdef CONF_DO_CHECKS
-            if (!((src + 2) <= in_end)) {
-              return 0;
-            }
+        if (!(dst < out_end)) {
+          stream->error = 1;
+          break;
+        }
 #endif
-            length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
-            const uint32_t b2 = (uint32_t)*src++;
-            offset = ((b & 0xe0) << 11) | (b2 << 8) | (*src++);
-            offset += 2056;
-          } else if (symbol == m2) {
-            // Medium copy.
+        *dst++ = symbol;
+      }
+    }
+  }
+
+  stream->dst = dst;
+  return src;
+}
+
+//-- PUBLIC ----------------------------------------------------------------------------------------
+
+uint32_t LZG_Decode(const uint8_t* in,
+                    const uint32_t insize,
+                    uint8_t* out,
+                    const uint32_t outsize) {
+  lzg_stream_t stream;
+  LZG_StreamInit(&stream, out, outsize);
+  (void)LZG_StreamFeed(&stream, in, insize);
+  return LZG_StreamDone(&stream);
+}
+
+void LZG_StreamInit(lzg_stream_t* stream, uint8_t* out, const uint32_t outsize) {
+  stream->out = out;
+  stream->dst = out;
+  stream->out_end = out + outsize;
+  stream->decoded_size = 0;
+  stream->encoded_left = 0;
+  stream->checksum = 0;
+  stream->checksum_a = 1;
+  stream->checksum_b = 0;
+  stream->prologue_size = LZG_HEADER_SIZE;
+  stream->num_prologue = 0;
+  stream->num_pending = 0;
+  stream->error = 0;
+}
+
+uint32_t LZG_StreamFeed(lzg_stream_t* stream, const uint8_t* in, const uint32_t insize) {
+  const uint8_t* src = in;
+  const uint8_t* in_end = in + insize;
+
+  // Collect the header.
+  while (stream->num_prologue < LZG_HEADER_SIZE && src < in_end) {
+    stream->prologue[stream->num_prologue++] = *src++;
+    if (stream->num_prologue == LZG_HEADER_SIZE) {
+      const uint8_t* hdr = stream->prologue;
 #ifdef CONF_DO_CHECKS
-            if (!(src < in_end)) {
-              return 0;
-            }
-#endif
-            length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
-            const uint32_t b2 = (uint32_t)*src++;
-            offset = ((b & 0xe0) << 3) | b2;
-            offset += 8;
-          } else if (symbol == m3) {
-            // Short copy.
-            length = (b >> 6) + 3;
-            offset = (b & 0x3f) + 8;
-          } else {
-            // Near copy (including RLE).
-            length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
-            offset = (b >> 5) + 1;
-          }
-
-          // Copy the corresponding data from the history window.
-          const uint8_t* copy = dst - offset;
+      // Check magic ID.
+      if ((hdr[0] != 'L') || (hdr[1] != 'Z') || (hdr[2] != 'G')) {
+        stream->error = 1;
+      }
+#endif  // CONF_DO_CHECKS
+
+      // Get header data. The LZG1 method has four marker symbols before the encoded data.
+      stream->decoded_size = _LZG_GetUINT32(hdr, 3);
+      stream->encoded_left = _LZG_GetUINT32(hdr, 7);
+      stream->checksum = _LZG_GetUINT32(hdr, 11);
+      if ((uint32_t)hdr[15] == LZG_METHOD_LZG1) {
+        stream->prologue_size = LZG_HEADER_SIZE + 4;
+      }
+
 #ifdef CONF_DO_CHECKS
-          if (!((copy >= out) && ((dst + length) <= out_end))) {
-            return 0;
-          }
-#endif
-          for (uint32_t i = 0u; i < length; ++i) {
-            *dst++ = *copy++;
-          }
-        } else {
-          // Literal copy (single occurance of a marker symbol).
+      // Check sizes.
+      if ((uint32_t)(stream->out_end - stream->out) < stream->decoded_size) {
+        stream->error = 1;
+      }
+#endif  // CONF_DO_CHECKS
+    }
+  }
+
+  // Do not read past the end of the encoded data.
+  if (stream->encoded_left < (uint32_t)(in_end - src)) {
+    in_end = src + stream->encoded_left;
+  }
+  stream->encoded_left -= (uint32_t)(in_end - src);
 #ifdef CONF_DO_CHECKS
-          if (!(dst < out_end)) {
-            return 0;
-          }
-#endif
-          *dst++ = symbol;
-        }
+  _LZG_UpdateChecksum(stream, src, (uint32_t)(in_end - src));
+  if (stream->error) {
+    return (uint32_t)(in_end - in);
+  }
+#endif  // CONF_DO_CHECKS
+
+  // Collect the marker symbols.
+  while (stream->num_prologue < stream->prologue_size && src < in_end) {
+    stream->prologue[stream->num_prologue++] = *src++;
+  }
+
+  // Check which method to use.
+  const uint32_t method = (uint32_t)stream->prologue[15];
+  if (stream->num_prologue < stream->prologue_size || src == in_end) {
+    // Nothing more to do.
+  } else if (method == LZG_METHOD_LZG1) {
+    // Complete a token that was split between two chunks.
+    if (stream->num_pending > 0) {
+      const uint8_t* markers = &stream->prologue[LZG_HEADER_SIZE];
+      uint8_t* pending = stream->pending;
+      while (src < in_end &&
+             _LZG_TokenSize(pending, stream->num_pending, markers) > stream->num_pending) {
+        pending[stream->num_pending++] = *src++;
+      }
+      if (_LZG_TokenSize(pending, stream->num_pending, markers) > stream->num_pending) {
+        return (uint32_t)(in_end - in);
       }
+      (void)_LZG_DecodeTokens(stream, pending, pending + stream->num_pending);
+      stream->num_pending = 0;
+    }
+
+    // Decode the complete tokens, and keep the bytes of an incomplete token for the next chunk.
+    src = _LZG_DecodeTokens(stream, src, in_end);
+#ifdef CONF_DO_CHECKS
+    if (stream->error) {
+      return (uint32_t)(in_end - in);
+    }
+#endif
+    while (src < in_end) {
+      stream->pending[stream->num_pending++] = *src++;
     }
   } else if (method == LZG_METHOD_COPY) {
     // Plain copy.
-    const uint32_t count = _LZG_Min((uint32_t)(in_end - src), (uint32_t)(out_end - dst));
+    const uint32_t count =
+        _LZG_Min((uint32_t)(in_end - src), (uint32_t)(stream->out_end - stream->dst));
+    uint8_t* dst = stream->dst;
     for (uint32_t i = 0u; i < count; ++i) {
       *dst++ = *src++;
     }
+    stream->dst = dst;
+  }
+
+  return (uint32_t)(in_end - in);
+}
 
+uint32_t LZG_StreamDecoded(const lzg_stream_t* stream) {
+  return (uint32_t)(stream->dst - stream->out);
+}
+
+uint32_t LZG_StreamDone(const lzg_stream_t* stream) {
+  if (stream->num_prologue < LZG_HEADER_SIZE || stream->encoded_left != 0u ||
+      stream->num_pending != 0u) {
+    return 0;
   }
 
 #ifdef CONF_DO_CHECKS
   // All OK?
-  if ((uint32_t)(dst - out) != decoded_size) {
+  const uint32_t checksum = (stream->checksum_b << 16) | stream->checksum_a;
+  if (stream->error || checksum != stream->checksum ||
+      (uint32_t)(stream->dst - stream->out) != stream->decoded_size) {
     return 0;
   }
 #endif
 
-  return decoded_size;
+  return stream->decoded_size;
 }
@@ -0,0 +1,374 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <mc1/mca_player.h>
+
+#include <mc1/lzg_mc1.h>
+#include <mc1/mmio.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+//--------------------------------------------------------------------------------------------------
+// MCA animation file format (see png2mci for a full description):
+//
+//  +---------+--------+----------------------------------+
+//  | Offset  | Size   | Description                      |
+//  +---------+--------+----------------------------------+
+//  | 0       | 20     | Header (mca_header_t)            |
+//  | 20      | 4 * Nc | Palette (Nc colors)              |
+//  | 20+4*Nc | 4 * Nf | Frame table (Nf frames)          |
+//  |         | 4      | End of the last frame            |
+//  |         |        | Frames                           |
+//  +---------+--------+----------------------------------+
+//
+// Each frame is a 32-bit frame type (MCA_FRAME_*), followed by LZG compressed data. The decoded
+// data of a delta frame is the number of spans (32 bits), followed by the spans (four 16-bit
+// values: row, first word, number of words and zero), followed by the pixel words of the spans.
+//
+// With MCA_FLAG_BLOCKS, the frame table is padded to a block boundary and every frame occupies a
+// whole number of blocks.
+//--------------------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------------------
+// Private.
+//--------------------------------------------------------------------------------------------------
+
+static int is_word_aligned(const uint8_t* ptr) {
+  return (((uint32_t)ptr) & 3u) == 0u;
+}
+
+static uint32_t get_stride(const mca_header_t* hdr) {
+  const uint32_t width = hdr->width;
+  const uint32_t bpp = 32u >> hdr->pixel_format;
+  return ((width * bpp + 31u) / 32u) * 4u;
+}
+
+static int fb_matches(const mca_header_t* hdr, const fb_t* fb) {
+  return fb != NULL && fb->width == (int)hdr->width && fb->height == (int)hdr->height &&
+         fb->mode == (int)hdr->pixel_format && fb->stride == (size_t)get_stride(hdr);
+}
+
+static void apply_delta(const mca_header_t* hdr, const uint8_t* delta, fb_t* fb) {
+  const uint32_t num_spans = *(const uint32_t*)delta;
+  const uint16_t* spans = (const uint16_t*)&delta[4];
+  const uint8_t* src = &delta[4u + 8u * num_spans];
+  uint8_t* pixels = (uint8_t*)fb->pixels;
+  const uint32_t stride = (uint32_t)fb->stride;
+
+  // Copy the spans, and keep track of the bounding rectangle of the changed pixels.
+  uint32_t x0 = 0xffffu;
+  uint32_t y0 = 0xffffu;
+  uint32_t x1 = 0u;
+  uint32_t y1 = 0u;
+  for (uint32_t i = 0u; i < num_spans; ++i) {
+    const uint32_t y = (uint32_t)spans[0];
+    const uint32_t x = (uint32_t)spans[1];
+    const uint32_t count = (uint32_t)spans[2];
+    spans += 4;
+    memcpy(&pixels[y * stride + x * 4u], src, count * 4u);
+    src += count * 4u;
+    x0 = x < x0 ? x : x0;
+    x1 = (x + count) > x1 ? (x + count) : x1;
+    y0 = y < y0 ? y : y0;
+    y1 = y >= y1 ? y + 1u : y1;
+  }
+
+  if (num_spans > 0u) {
+    // Convert words to pixels (there are 1 << pixel_format pixels per word).
+    const uint32_t shift = hdr->pixel_format;
+    fb_add_dirty(fb,
+                 (int)(x0 << shift),
+                 (int)y0,
+                 (int)((x1 - x0) << shift),
+                 (int)(y1 - y0));
+  }
+}
+
+// Number of blocks to read at a time while waiting for the next frame to become due. This keeps
+// the reads large enough for efficient multi-block transfers, while still keeping the pacing
+// accurate.
+#define READ_AHEAD_BLOCKS 8u
+
+static uint32_t div_blocks(uint32_t size) {
+  return (size + (MCA_BLOCK_SIZE - 1u)) / MCA_BLOCK_SIZE;
+}
+
+static int stream_read_frame(mca_stream_t* stream, uint32_t max_blocks) {
+  const uint32_t frame = stream->next_frame;
+  const uint32_t first_block = stream->frames[frame] / MCA_BLOCK_SIZE;
+  const uint32_t num_blocks = stream->frames[frame + 1u] / MCA_BLOCK_SIZE - first_block;
+  uint32_t count = num_blocks - stream->blocks_read;
+  count = count < max_blocks ? count : max_blocks;
+  if (count > 0u) {
+    if (!stream->read_blocks(&stream->frame_buf[stream->blocks_read * MCA_BLOCK_SIZE],
+                             first_block + stream->blocks_read,
+                             count,
+                             stream->custom)) {
+      return 0;
+    }
+    stream->blocks_read += count;
+  }
+  return 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Public API.
+//--------------------------------------------------------------------------------------------------
+
+const mca_header_t* mca_get_header(const uint8_t* mca_data) {
+  // The magic ID is "MCA1", or 0x3141434d in hex (little endian).
+  if (mca_data == NULL || !is_word_aligned(mca_data) ||
+      *((const uint32_t*)mca_data) != 0x3141434du) {
+    return NULL;
+  }
+  return (const mca_header_t*)mca_data;
+}
+
+int mca_decode_frame(const mca_header_t* hdr,
+                     const uint8_t* frame,
+                     uint32_t size,
+                     fb_t* fb,
+                     uint8_t* delta_buf) {
+  if (size < 4u || !is_word_aligned(frame)) {
+    return 0;
+  }
+  const uint32_t type = *(const uint32_t*)frame;
+  const uint8_t* lzg_data = &frame[4];
+  const uint32_t lzg_size = size - 4u;
+
+  if (type == MCA_FRAME_KEY) {
+    // Decode the entire frame directly into the framebuffer.
+    const uint32_t pixels_size = get_stride(hdr) * hdr->height;
+    if (LZG_Decode(lzg_data, lzg_size, (uint8_t*)fb->pixels, pixels_size) != pixels_size) {
+      return 0;
+    }
+    fb_add_dirty(fb, 0, 0, fb->width, fb->height);
+    return 1;
+  }
+
+  if (type == MCA_FRAME_DELTA && delta_buf != NULL) {
+    // Decode the spans, and copy them to the framebuffer.
+    if (LZG_Decode(lzg_data, lzg_size, delta_buf, hdr->max_delta_size) == 0u) {
+      return 0;
+    }
+    apply_delta(hdr, delta_buf, fb);
+    return 1;
+  }
+
+  return 0;
+}
+
+int mca_player_init(mca_player_t* player, const uint8_t* mca_data, fb_t* fb0, fb_t* fb1) {
+  const mca_header_t* hdr = mca_get_header(mca_data);
+  if (hdr == NULL || hdr->num_frames == 0u || !fb_matches(hdr, fb0) || !fb_matches(hdr, fb1)) {
+    return 0;
+  }
+
+  player->data = mca_data;
+  player->hdr = hdr;
+  player->frames = (const uint32_t*)&mca_data[sizeof(mca_header_t) + 4u * hdr->num_pal_colors];
+  player->fb[0] = fb0;
+  player->fb[1] = fb1;
+  player->delta_buf = NULL;
+  if (hdr->max_delta_size > 0u) {
+    player->delta_buf = (uint8_t*)malloc(hdr->max_delta_size);
+    if (player->delta_buf == NULL) {
+      return 0;
+    }
+  }
+
+  // Load the palette.
+  const uint32_t* palette = (const uint32_t*)&mca_data[sizeof(mca_header_t)];
+  for (int i = 0; i < 2; ++i) {
+    if (player->fb[i]->palette != NULL) {
+      memcpy(player->fb[i]->palette, palette, 4u * (uint32_t)hdr->num_pal_colors);
+    }
+  }
+
+  mca_player_rewind(player);
+  return 1;
+}
+
+void mca_player_deinit(mca_player_t* player) {
+  free(player->delta_buf);
+  player->delta_buf = NULL;
+}
+
+fb_t* mca_player_next(mca_player_t* player) {
+  const uint32_t frame = player->next_frame;
+  const uint32_t start = player->frames[frame];
+  fb_t* fb = player->fb[player->back];
+  if (!mca_decode_frame(player->hdr,
+                        &player->data[start],
+                        player->frames[frame + 1u] - start,
+                        fb,
+                        player->delta_buf)) {
+    return NULL;
+  }
+
+  player->next_frame = (frame + 1u) < player->hdr->num_frames ? (frame + 1u) : 0u;
+  player->back ^= 1;
+  return fb;
+}
+
+void mca_player_rewind(mca_player_t* player) {
+  player->next_frame = 0u;
+  player->back = 0;
+}
+
+int mca_stream_init(mca_stream_t* stream,
+                    mca_read_blocks_fun_t read_blocks,
+                    void* custom,
+                    fb_t* fb0,
+                    fb_t* fb1) {
+  memset(stream, 0, sizeof(mca_stream_t));
+  stream->read_blocks = read_blocks;
+  stream->custom = custom;
+
+  // Read the first block, which holds the header.
+  uint8_t* first_block = (uint8_t*)malloc(MCA_BLOCK_SIZE);
+  if (first_block == NULL) {
+    return 0;
+  }
+  if (!read_blocks(first_block, 0u, 1u, custom)) {
+    free(first_block);
+    return 0;
+  }
+  const mca_header_t* hdr = mca_get_header(first_block);
+  if (hdr == NULL || (hdr->flags & MCA_FLAG_BLOCKS) == 0u || hdr->num_frames == 0u ||
+      !fb_matches(hdr, fb0) || !fb_matches(hdr, fb1)) {
+    free(first_block);
+    return 0;
+  }
+
+  // Read the rest of the header, palette and frame table.
+  const uint32_t header_size =
+      sizeof(mca_header_t) + 4u * ((uint32_t)hdr->num_pal_colors + hdr->num_frames + 1u);
+  const uint32_t header_blocks = div_blocks(header_size);
+  stream->header_buf = (uint8_t*)malloc(header_blocks * MCA_BLOCK_SIZE);
+  if (stream->header_buf == NULL) {
+    free(first_block);
+    return 0;
+  }
+  memcpy(stream->header_buf, first_block, MCA_BLOCK_SIZE);
+  free(first_block);
+  if (header_blocks > 1u &&
+      !read_blocks(&stream->header_buf[MCA_BLOCK_SIZE], 1u, header_blocks - 1u, custom)) {
+    mca_stream_deinit(stream);
+    return 0;
+  }
+  stream->hdr = (const mca_header_t*)stream->header_buf;
+  stream->frames = (const uint32_t*)&stream->header_buf[sizeof(mca_header_t) +
+                                                         4u * stream->hdr->num_pal_colors];
+
+  // Find the largest frame (all frames must be block aligned).
+  uint32_t max_frame_size = 0u;
+  for (uint32_t i = 0u; i < stream->hdr->num_frames; ++i) {
+    const uint32_t start = stream->frames[i];
+    const uint32_t end = stream->frames[i + 1u];
+    if ((start % MCA_BLOCK_SIZE) != 0u || (end % MCA_BLOCK_SIZE) != 0u || end < start) {
+      mca_stream_deinit(stream);
+      return 0;
+    }
+    max_frame_size = (end - start) > max_frame_size ? (end - start) : max_frame_size;
+  }
+
+  // Allocate the frame buffers.
+  stream->frame_buf = (uint8_t*)malloc(max_frame_size);
+  if (stream->frame_buf == NULL) {
+    mca_stream_deinit(stream);
+    return 0;
+  }
+  if (stream->hdr->max_delta_size > 0u) {
+    stream->delta_buf = (uint8_t*)malloc(stream->hdr->max_delta_size);
+    if (stream->delta_buf == NULL) {
+      mca_stream_deinit(stream);
+      return 0;
+    }
+  }
+  stream->fb[0] = fb0;
+  stream->fb[1] = fb1;
+
+  // Load the palette.
+  const uint32_t* palette = (const uint32_t*)&stream->header_buf[sizeof(mca_header_t)];
+  for (int i = 0; i < 2; ++i) {
+    if (stream->fb[i]->palette != NULL) {
+      memcpy(stream->fb[i]->palette, palette, 4u * (uint32_t)stream->hdr->num_pal_colors);
+    }
+  }
+
+  // Read the first frame.
+  if (!stream_read_frame(stream, 0xffffffffu)) {
+    mca_stream_deinit(stream);
+    return 0;
+  }
+  stream->due_frame_no = MMIO(VIDFRAMENO);
+
+  return 1;
+}
+
+void mca_stream_deinit(mca_stream_t* stream) {
+  free(stream->delta_buf);
+  free(stream->frame_buf);
+  free(stream->header_buf);
+  stream->delta_buf = NULL;
+  stream->frame_buf = NULL;
+  stream->header_buf = NULL;
+}
+
+fb_t* mca_stream_next(mca_stream_t* stream) {
+  // Read the remaining blocks of the frame, if any (normally the entire frame has already been read
+  // while the previous frame was shown).
+  if (!stream_read_frame(stream, 0xffffffffu)) {
+    return NULL;
+  }
+
+  // Decode the frame.
+  const uint32_t frame = stream->next_frame;
+  fb_t* fb = stream->fb[stream->back];
+  if (!mca_decode_frame(stream->hdr,
+                        stream->frame_buf,
+                        stream->frames[frame + 1u] - stream->frames[frame],
+                        fb,
+                        stream->delta_buf)) {
+    return NULL;
+  }
+  stream->next_frame = (frame + 1u) < stream->hdr->num_frames ? (frame + 1u) : 0u;
+  stream->blocks_read = 0u;
+  stream->back ^= 1;
+
+  // Read the following frame while waiting for this frame to become due.
+  while ((int32_t)(MMIO(VIDFRAMENO) - stream->due_frame_no) < 0) {
+    if (!stream_read_frame(stream, READ_AHEAD_BLOCKS)) {
+      return NULL;
+    }
+  }
+
+  // Schedule the following frame. If we are falling behind, restart the pacing from now.
+  const uint32_t frame_period = stream->hdr->frame_period > 0u ? stream->hdr->frame_period : 1u;
+  const uint32_t frame_no = MMIO(VIDFRAMENO);
+  stream->due_frame_no += frame_period;
+  if ((int32_t)(frame_no - stream->due_frame_no) >= 0) {
+    stream->due_frame_no = frame_no + frame_period;
+  }
+
+  return fb;
+}
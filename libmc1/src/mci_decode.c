@@ -20,8 +20,10 @@
 
 #include <mc1/mci_decode.h>
 
+#include <mc1/gfx.h>
 #include <mc1/lzg_mc1.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 //--------------------------------------------------------------------------------------------------
@@ -50,6 +52,14 @@
 //  | 16+4*Nc | Nb     | Pixel data (Nb bytes)    |
 //  +---------+--------+--------------------------+
 //
+// For MCI_COMP_LZG_INPLACE, the pixel data starts with a 32-bit word that holds the in-place
+// decoding margin (in bytes), followed by the LZG data (Nb - 4 bytes).
+//
+// For MCI_COMP_LZG_BANDS, the image is split into bands of R rows (the last band may be shorter)
+// that are compressed separately. The pixel data starts with a table of N + 2 32-bit words, where
+// N is the number of bands: R, followed by the offsets of the LZG data of the N bands (relative to
+// the start of the pixel data), followed by the end offset of the last band.
+//
 //--------------------------------------------------------------------------------------------------
 
 //--------------------------------------------------------------------------------------------------
@@ -65,6 +75,26 @@ static int has_magic_id(const uint8_t* ptr) {
   return *((const uint32_t*)ptr) == 0x3149434du;
 }
 
+static uint32_t min_u32(const uint32_t a, const uint32_t b) {
+  return a < b ? a : b;
+}
+
+static int min_int(const int a, const int b) {
+  return a < b ? a : b;
+}
+
+static int max_int(const int a, const int b) {
+  return a > b ? a : b;
+}
+
+// Number of LZG bytes to decode at a time when only a part of an LZG image is decoded.
+#define LZG_CHUNK_SIZE 1024u
+
+// Size of the in-place decoding margin field that precedes the LZG data (MCI_COMP_LZG_INPLACE).
+static uint32_t get_margin_field_size(const mci_header_t* hdr) {
+  return hdr->compression == MCI_COMP_LZG_INPLACE ? 4u : 0u;
+}
+
 static const uint32_t* get_palette_data(const mci_header_t* hdr) {
   const uint8_t* base = (const uint8_t*)hdr;
   return (const uint32_t*)(base + sizeof(mci_header_t));
@@ -75,6 +105,45 @@ static const uint8_t* get_pixel_data(const mci_header_t* hdr) {
   return base + sizeof(mci_header_t) + 4 * hdr->num_pal_colors;
 }
 
+static const uint32_t* get_band_table(const mci_header_t* hdr) {
+  return (const uint32_t*)get_pixel_data(hdr);
+}
+
+// Decode the image rows [y0, y1) to pixels. Whole bands are decoded (see mci_get_band_rows()), and
+// pixels points to the first row of the band that holds row y0.
+static void decode_rows(const mci_header_t* hdr, uint8_t* pixels, uint32_t y0, uint32_t y1) {
+  const uint8_t* pixel_data = get_pixel_data(hdr);
+  const uint32_t stride = mci_get_stride(hdr);
+  if (hdr->compression == MCI_COMP_NONE) {
+    memcpy(pixels, &pixel_data[y0 * stride], (y1 - y0) * stride);
+  } else if (hdr->compression == MCI_COMP_LZG_BANDS) {
+    const uint32_t* table = get_band_table(hdr);
+    const uint32_t band_rows = table[0];
+    for (uint32_t band = y0 / band_rows; band * band_rows < y1; ++band) {
+      const uint32_t rows = min_u32(band_rows, hdr->height - band * band_rows);
+      const uint32_t start = table[band + 1];
+      LZG_Decode(&pixel_data[start], table[band + 2] - start, pixels, rows * stride);
+      pixels += rows * stride;
+    }
+  } else {
+    const uint32_t skip = get_margin_field_size(hdr);
+    const uint8_t* lzg_data = &pixel_data[skip];
+    const uint32_t lzg_size = hdr->pixel_data_size - skip;
+    const uint32_t pixels_size = mci_get_pixels_size(hdr);
+    if (y1 == hdr->height) {
+      LZG_Decode(lzg_data, lzg_size, pixels, pixels_size);
+    } else {
+      // Stop decoding once the requested rows are ready.
+      const uint32_t needed = y1 * stride;
+      lzg_stream_t stream;
+      LZG_StreamInit(&stream, pixels, pixels_size);
+      for (uint32_t pos = 0u; pos < lzg_size && LZG_StreamDecoded(&stream) < needed;) {
+        pos += LZG_StreamFeed(&stream, &lzg_data[pos], min_u32(lzg_size - pos, LZG_CHUNK_SIZE));
+      }
+    }
+  }
+}
+
 
 //--------------------------------------------------------------------------------------------------
 // Public API.
@@ -99,6 +168,15 @@ uint32_t mci_get_pixels_size(const mci_header_t* hdr) {
   return mci_get_stride(hdr) * hdr->height;
 }
 
+uint32_t mci_get_band_rows(const mci_header_t* hdr) {
+  if (hdr->compression == MCI_COMP_NONE) {
+    return 1u;
+  } else if (hdr->compression == MCI_COMP_LZG_BANDS) {
+    return get_band_table(hdr)[0];
+  }
+  return hdr->height;
+}
+
 void mci_decode_palette(const uint8_t* mci_data, uint32_t* palette) {
   const mci_header_t* hdr = mci_get_header(mci_data);
   if (hdr == NULL) {
@@ -110,21 +188,145 @@ void mci_decode_palette(const uint8_t* mci_data, uint32_t* palette) {
 }
 
 void mci_decode_pixels(const uint8_t* mci_data, uint32_t* pixels) {
+  const mci_header_t* hdr = mci_get_header(mci_data);
+  if (hdr == NULL || hdr->compression > MCI_COMP_LZG_BANDS) {
+    return;
+  }
+
+  // Uncompress the pixel data.
+  decode_rows(hdr, (uint8_t*)pixels, 0u, hdr->height);
+}
+
+void mci_decode_rows(const uint8_t* mci_data,
+                     uint32_t* pixels,
+                     uint32_t first_row,
+                     uint32_t num_rows) {
+  const mci_header_t* hdr = mci_get_header(mci_data);
+  if (hdr == NULL || hdr->compression > MCI_COMP_LZG_BANDS || first_row >= hdr->height) {
+    return;
+  }
+
+  // Decode the bands that hold the requested rows.
+  const uint32_t y1 = first_row + min_u32(num_rows, hdr->height - first_row);
+  const uint32_t band_rows = mci_get_band_rows(hdr);
+  const uint32_t band_start = (first_row / band_rows) * band_rows;
+  decode_rows(hdr, &((uint8_t*)pixels)[band_start * mci_get_stride(hdr)], first_row, y1);
+}
+
+uint32_t mci_get_inplace_size(const uint8_t* mci_data) {
   const mci_header_t* hdr = mci_get_header(mci_data);
   if (hdr == NULL) {
+    return 0;
+  }
+  if (hdr->compression != MCI_COMP_LZG_INPLACE) {
+    return mci_get_pixels_size(hdr);
+  }
+
+  // The margin is stored as a 32-bit little endian word before the LZG data.
+  const uint8_t* margin = get_pixel_data(hdr);
+  return mci_get_pixels_size(hdr) + ((uint32_t)margin[0] | ((uint32_t)margin[1] << 8) |
+                                     ((uint32_t)margin[2] << 16) | ((uint32_t)margin[3] << 24));
+}
+
+uint32_t mci_get_inplace_offset(const uint8_t* mci_data) {
+  const mci_header_t* hdr = mci_get_header(mci_data);
+  if (hdr == NULL || hdr->compression != MCI_COMP_LZG_INPLACE) {
+    return 0;
+  }
+  return mci_get_inplace_size(mci_data) - (hdr->pixel_data_size - get_margin_field_size(hdr));
+}
+
+void mci_decode_pixels_inplace(const uint8_t* mci_data, uint32_t* pixels) {
+  const mci_header_t* hdr = mci_get_header(mci_data);
+  if (hdr == NULL || hdr->compression != MCI_COMP_LZG_INPLACE) {
     return;
   }
 
-  // Get pixel data info.
-  const uint8_t* pixel_data = get_pixel_data(hdr);
-  const uint32_t unpacked_size = mci_get_pixels_size(hdr);
+  // The LZG data has been loaded at the end of the pixel buffer, and the margin guarantees that
+  // the decoder never overwrites LZG data that it has not read yet.
+  const uint8_t* lzg_data = &((const uint8_t*)pixels)[mci_get_inplace_offset(mci_data)];
+  LZG_Decode(lzg_data,
+             hdr->pixel_data_size - get_margin_field_size(hdr),
+             (uint8_t*)pixels,
+             mci_get_pixels_size(hdr));
+}
 
-  // Uncompress the pixel data.
+int mci_decode_to_fb(const uint8_t* mci_data,
+                     fb_t* fb,
+                     int dst_x,
+                     int dst_y,
+                     const fb_rect_t* src_rect) {
+  const mci_header_t* hdr = mci_get_header(mci_data);
+  if (hdr == NULL || (int)hdr->pixel_format != fb->mode ||
+      hdr->compression > MCI_COMP_LZG_BANDS) {
+    return 0;
+  }
+
+  // Load the palette.
+  if (fb->palette != NULL) {
+    mci_decode_palette(mci_data, fb->palette);
+  }
+
+  // Limit the source rectangle to the image and to the clip rectangle of the framebuffer.
+  const int width = (int)hdr->width;
+  const int height = (int)hdr->height;
+  fb_rect_t r = {0, 0, width, height};
+  if (src_rect != NULL) {
+    r = *src_rect;
+  }
+  const int dx = dst_x - r.x0;
+  const int dy = dst_y - r.y0;
+  r.x0 = max_int(max_int(r.x0, 0), fb->clip.x0 - dx);
+  r.y0 = max_int(max_int(r.y0, 0), fb->clip.y0 - dy);
+  r.x1 = min_int(min_int(r.x1, width), fb->clip.x1 - dx);
+  r.y1 = min_int(min_int(r.y1, height), fb->clip.y1 - dy);
+  if (r.x1 <= r.x0 || r.y1 <= r.y0) {
+    return 1;
+  }
+
+  const uint32_t stride = mci_get_stride(hdr);
+
+  // Decode the entire image directly into the framebuffer, if possible.
+  if (r.x0 == 0 && r.y0 == 0 && r.x1 == width && r.y1 == height && dx == 0 &&
+      width == fb->width && stride == (uint32_t)fb->stride) {
+    decode_rows(hdr, &((uint8_t*)fb->pixels)[(uint32_t)dy * stride], 0u, hdr->height);
+    fb_add_dirty(fb, 0, dy, width, height);
+    return 1;
+  }
+
+  // Wrap the source rows in a framebuffer object (all rows before r.y0 are skipped).
+  fb_t src;
+  memset(&src, 0, sizeof(src));
+  src.stride = stride;
+  src.width = width;
+  src.height = r.y1 - r.y0;
+  src.mode = fb->mode;
+  uint8_t* buf = NULL;
   if (hdr->compression == MCI_COMP_NONE) {
-    memcpy(pixels, pixel_data, unpacked_size);
-  } else if (hdr->compression == MCI_COMP_LZG) {
-    LZG_Decode(pixel_data, hdr->pixel_data_size, (uint8_t*)pixels, unpacked_size);
+    src.pixels = (void*)&get_pixel_data(hdr)[(uint32_t)r.y0 * stride];
+  } else {
+    // Decode the bands that hold the rows [r.y0, r.y1) to a temporary buffer. Plain LZG data can
+    // only be decoded from the start, and may be decoded past r.y1, so it needs a full buffer.
+    const uint32_t band_rows = mci_get_band_rows(hdr);
+    const uint32_t band_start = ((uint32_t)r.y0 / band_rows) * band_rows;
+    const uint32_t band_end = min_u32(
+        (((uint32_t)r.y1 + band_rows - 1u) / band_rows) * band_rows, hdr->height);
+    buf = (uint8_t*)malloc((band_end - band_start) * stride);
+    if (buf == NULL) {
+      return 0;
+    }
+    decode_rows(hdr, buf, (uint32_t)r.y0, (uint32_t)r.y1);
+    src.pixels = &buf[((uint32_t)r.y0 - band_start) * stride];
   }
+
+  // Copy the rows to the framebuffer.
+  const int blend = fb->blend;
+  fb->blend = GFX_BLEND_NONE;
+  gfx_blit(fb, dx + r.x0, dy + r.y0, &src, r.x0, 0, r.x1 - r.x0, r.y1 - r.y0);
+  fb->blend = blend;
+
+  free(buf);
+  return 1;
 }
 
 const uint32_t* mci_get_raw_pixels(const uint8_t* mci_data) {
@@ -137,3 +339,83 @@ const uint32_t* mci_get_raw_pixels(const uint8_t* mci_data) {
   const uint8_t* pixel_data = get_pixel_data(hdr);
   return is_word_aligned(pixel_data) ? (const uint32_t*)pixel_data : NULL;
 }
+
+int mci_stream_init(mci_stream_t* stream,
+                    const mci_header_t* hdr,
+                    uint32_t* pixels,
+                    uint32_t* palette) {
+  if (hdr == NULL || !has_magic_id((const uint8_t*)hdr) || hdr->width == 0u ||
+      hdr->compression > MCI_COMP_LZG_INPLACE) {
+    return 0;
+  }
+
+  stream->hdr = *hdr;
+  stream->pixels = (uint8_t*)pixels;
+  stream->palette = (uint8_t*)palette;
+  stream->stride = mci_get_stride(hdr);
+  stream->pixels_size = mci_get_pixels_size(hdr);
+  stream->offset = 0;
+  stream->copied = 0;
+  LZG_StreamInit(&stream->lzg, stream->pixels, stream->pixels_size);
+  return 1;
+}
+
+uint32_t mci_stream_feed(mci_stream_t* stream, const uint8_t* data, uint32_t size) {
+  const mci_header_t* hdr = &stream->hdr;
+  const uint32_t palette_start = sizeof(mci_header_t);
+  const uint32_t pixels_start = palette_start + 4u * (uint32_t)hdr->num_pal_colors;
+  const uint32_t end = pixels_start + hdr->pixel_data_size;
+
+  // Do not read past the end of the MCI data.
+  if (size > end - stream->offset) {
+    size = end - stream->offset;
+  }
+  const uint8_t* data_end = data + size;
+
+  // Skip the header, and copy the palette.
+  if (stream->offset < pixels_start) {
+    uint32_t count = min_u32(pixels_start - stream->offset, size);
+    if (stream->offset < palette_start) {
+      const uint32_t skip = min_u32(palette_start - stream->offset, count);
+      data += skip;
+      count -= skip;
+      stream->offset += skip;
+    }
+    if (stream->palette != NULL) {
+      memcpy(&stream->palette[stream->offset - palette_start], data, count);
+    }
+    data += count;
+    stream->offset += count;
+  }
+
+  // Skip the in-place decoding margin (it is not needed when streaming).
+  const uint32_t lzg_start = pixels_start + get_margin_field_size(hdr);
+  if (stream->offset < lzg_start) {
+    const uint32_t skip = min_u32(lzg_start - stream->offset, (uint32_t)(data_end - data));
+    data += skip;
+    stream->offset += skip;
+  }
+
+  // Decode the pixel data.
+  const uint32_t count = (uint32_t)(data_end - data);
+  if (count > 0u) {
+    if (hdr->compression == MCI_COMP_NONE) {
+      const uint32_t copy_count = min_u32(count, stream->pixels_size - stream->copied);
+      memcpy(&stream->pixels[stream->copied], data, copy_count);
+      stream->copied += copy_count;
+    } else {
+      (void)LZG_StreamFeed(&stream->lzg, data, count);
+    }
+    stream->offset += count;
+  }
+
+  return size;
+}
+
+uint32_t mci_stream_rows_ready(const mci_stream_t* stream) {
+  const uint32_t decoded = (stream->hdr.compression == MCI_COMP_NONE)
+                               ? stream->copied
+                               : LZG_StreamDecoded(&stream->lzg);
+  const uint32_t rows = decoded / stream->stride;
+  return rows < stream->hdr.height ? rows : stream->hdr.height;
+}
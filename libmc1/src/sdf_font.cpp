@@ -0,0 +1,297 @@
+// -*- mode: c++; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <mc1/sdf_font.h>
+
+#include <mc1/glyph_font.h>
+#include <mc1/mci_decode.h>
+#include <mc1/surface.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+using namespace mc1::glyph_font;
+using mc1::surface_detail::scale_u8x4;
+
+// Sub-pixel precision of the atlas sampling coordinates.
+constexpr int FRAC_BITS = 16;
+constexpr int32_t ONE = 1 << FRAC_BITS;
+
+// Width of the anti-aliasing ramp, in destination pixels.
+constexpr float AA_WIDTH = 1.4f;
+
+// Blend the color s over the RGBA8888 pixel d, with the coverage a (0-255). The alpha of the result
+// is a + d.a * (1 - a), as for GFX_BLEND_OVER.
+inline uint32_t blend_rgba8888(const uint32_t d, const uint32_t s, const uint32_t a) {
+  if (a == 255U) {
+    return s | 0xff000000U;
+  }
+  if (a == 0U) {
+    return d;
+  }
+  // The two scaled terms sum to at most 255 per byte, so no saturation is needed.
+  return scale_u8x4(s | 0xff000000U, a + 1U) + scale_u8x4(d, 256U - a);
+}
+
+// Map SDF values to coverage with a smoothstep ramp around the glyph edge. The ramp width is given
+// in atlas value units.
+void build_coverage_lut(uint8_t* lut, const float ramp_width) {
+  const float inv_width = 1.0f / ramp_width;
+  for (int v = 0; v < 256; ++v) {
+    float t = static_cast<float>(v - static_cast<int>(SDF_EDGE_VALUE)) * inv_width + 0.5f;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    lut[v] = static_cast<uint8_t>(t * t * (3.0f - 2.0f * t) * 255.0f + 0.5f);
+  }
+}
+
+// A glyph cell of the atlas, sampled with bilinear filtering. The sample coordinates are in atlas
+// pixels, with FRAC_BITS fractional bits, and are clamped to the cell (so that neighbouring glyphs
+// do not bleed into the glyph).
+class cell_sampler_t {
+public:
+  cell_sampler_t(const sdf_font_t* font, const unsigned c)
+      : m_stride(font->stride), m_max(font->cell_size - 1) {
+    const unsigned idx = c - SDF_FIRST_CHAR;
+    const auto cell_x = static_cast<uint32_t>(font->cell_size) * (idx % SDF_ATLAS_COLUMNS);
+    const auto cell_y = static_cast<uint32_t>(font->cell_size) * (idx / SDF_ATLAS_COLUMNS);
+    m_cell = &font->pixels[cell_y * m_stride + cell_x];
+  }
+
+  // Set up the row for the sample coordinate v.
+  void set_row(const int32_t v) {
+    const int32_t y = clamp_coord(v);
+    const int row = y >> FRAC_BITS;
+    m_row0 = &m_cell[static_cast<uint32_t>(row) * m_stride];
+    m_row1 = (row < m_max) ? &m_row0[m_stride] : m_row0;
+    m_fy = static_cast<uint32_t>(y >> (FRAC_BITS - 8)) & 255U;
+  }
+
+  // Sample the current row at the sample coordinate u.
+  uint32_t sample(const int32_t u) const {
+    const int32_t x = clamp_coord(u);
+    const int col0 = x >> FRAC_BITS;
+    const int col1 = (col0 < m_max) ? col0 + 1 : col0;
+    const uint32_t fx = static_cast<uint32_t>(x >> (FRAC_BITS - 8)) & 255U;
+    const uint32_t top = static_cast<uint32_t>(m_row0[col0]) * (256U - fx) + m_row0[col1] * fx;
+    const uint32_t bottom = static_cast<uint32_t>(m_row1[col0]) * (256U - fx) + m_row1[col1] * fx;
+    return (top * (256U - m_fy) + bottom * m_fy) >> 16;
+  }
+
+private:
+  int32_t clamp_coord(const int32_t t) const {
+    return std::min(std::max(t, 0), m_max << FRAC_BITS);
+  }
+
+  const uint8_t* m_cell;
+  const uint8_t* m_row0 = nullptr;
+  const uint8_t* m_row1 = nullptr;
+  const uint32_t m_stride;
+  const int m_max;
+  uint32_t m_fy = 0U;
+};
+
+// Advance width of a character, in pixels with FRAC_BITS fractional bits.
+int32_t advance_width(const unsigned char c, const int size) {
+  return (static_cast<int32_t>(FONT_INDEX.advance[c]) * size) << (FRAC_BITS - 3);
+}
+
+template <int CMODE>
+void draw_glyph(fb_t* fb,
+                const sdf_font_t* font,
+                const unsigned c,
+                const int x,
+                const int y,
+                const int size,
+                const uint8_t* lut,
+                const uint32_t color) {
+  // Clip the glyph cell.
+  const auto& clip = fb->clip;
+  const int x0 = std::max(x, clip.x0);
+  const int y0 = std::max(y, clip.y0);
+  const int x1 = std::min(x + size, clip.x1);
+  const int y1 = std::min(y + size, clip.y1);
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  // Map destination pixel centers to atlas pixel centers.
+  const int32_t step = (font->cell_size << FRAC_BITS) / size;
+  const int32_t u0 = step / 2 - ONE / 2 + (x0 - x) * step;
+  int32_t v = step / 2 - ONE / 2 + (y0 - y) * step;
+
+  const uint32_t alpha = color >> 24;
+  mc1::surface_t<CMODE> surf(fb);
+  cell_sampler_t sampler(font, c);
+  for (int yy = y0; yy < y1; ++yy, v += step) {
+    sampler.set_row(v);
+    auto it = surf.row(yy, x0);
+    int32_t u = u0;
+    for (int xx = x0; xx < x1; ++xx, u += step, ++it) {
+      const uint32_t coverage = lut[sampler.sample(u)];
+      if constexpr (CMODE == CMODE_RGBA8888) {
+        const uint32_t a = (coverage * alpha + 255U) >> 8;
+        if (a != 0U) {
+          it.put(blend_rgba8888(it.get(), color, a));
+        }
+      } else {
+        if (coverage >= 128U) {
+          it.put(color);
+        }
+      }
+    }
+  }
+}
+
+template <int CMODE>
+void draw_text(fb_t* fb,
+               const sdf_font_t* font,
+               const int x,
+               const int y,
+               const int size,
+               const char* text,
+               const uint32_t color) {
+  // The smoothstep ramp is AA_WIDTH destination pixels wide, and one destination pixel is
+  // cell_size / size atlas pixels.
+  uint8_t lut[256];
+  const float atlas_pixels = static_cast<float>(font->cell_size) / static_cast<float>(size);
+  build_coverage_lut(lut, std::max(AA_WIDTH * atlas_pixels * SDF_DIST_SCALE, 1.0f));
+
+  int32_t pen_x = 0;
+  int pen_y = y;
+  int max_x = x;
+  for (; *text != 0; ++text) {
+    const auto c = static_cast<unsigned char>(*text);
+    if (c == '\n') {
+      pen_x = 0;
+      pen_y += size;
+      continue;
+    }
+    const int glyph_x = x + ((pen_x + ONE / 2) >> FRAC_BITS);
+    const bool in_atlas = (c >= SDF_FIRST_CHAR && c < SDF_FIRST_CHAR + SDF_NUM_CHARS);
+    if (in_atlas && FONT_INDEX.offset[c] != NO_GLYPH) {
+      draw_glyph<CMODE>(fb, font, c, glyph_x, pen_y, size, lut, color);
+      max_x = std::max(max_x, glyph_x + size);
+    }
+    pen_x += advance_width(c, size);
+  }
+
+  // Mark the drawn part of the text box as dirty.
+  const auto& clip = fb->clip;
+  const int x0 = std::max(x, clip.x0);
+  const int y0 = std::max(y, clip.y0);
+  const int x1 = std::min(max_x, clip.x1);
+  const int y1 = std::min(pen_y + size, clip.y1);
+  fb_add_dirty(fb, x0, y0, x1 - x0, y1 - y0);
+}
+
+}  // namespace
+
+extern "C" int sdf_font_init(sdf_font_t* font, const uint8_t* mci_data) {
+  font->pixels = nullptr;
+  font->owns_pixels = 0;
+
+  // The atlas must be a PAL8 image with whole glyph cells.
+  const mci_header_t* hdr = mci_get_header(mci_data);
+  if (hdr == nullptr || hdr->pixel_format != MCI_PIXFMT_PAL8) {
+    return 0;
+  }
+  const unsigned cell_size = hdr->width / SDF_ATLAS_COLUMNS;
+  const unsigned rows = (SDF_NUM_CHARS + SDF_ATLAS_COLUMNS - 1) / SDF_ATLAS_COLUMNS;
+  if (cell_size < 1U || hdr->width != cell_size * SDF_ATLAS_COLUMNS ||
+      hdr->height != cell_size * rows) {
+    return 0;
+  }
+  font->stride = mci_get_stride(hdr);
+  font->cell_size = static_cast<int>(cell_size);
+
+  // Use uncompressed pixels in place, and decode compressed pixels to the heap.
+  if (hdr->compression == MCI_COMP_NONE) {
+    font->pixels = reinterpret_cast<const uint8_t*>(mci_get_raw_pixels(mci_data));
+  } else {
+    auto* pixels = static_cast<uint32_t*>(malloc(mci_get_pixels_size(hdr)));
+    if (pixels != nullptr) {
+      mci_decode_pixels(mci_data, pixels);
+      font->pixels = reinterpret_cast<const uint8_t*>(pixels);
+      font->owns_pixels = 1;
+    }
+  }
+  return font->pixels != nullptr ? 1 : 0;
+}
+
+extern "C" void sdf_font_deinit(sdf_font_t* font) {
+  if (font->owns_pixels) {
+    free(const_cast<uint8_t*>(font->pixels));
+  }
+  font->pixels = nullptr;
+  font->owns_pixels = 0;
+}
+
+extern "C" int sdf_font_text_width(const sdf_font_t* font, int size, const char* text) {
+  (void)font;
+  int32_t width = 0;
+  int32_t pen_x = 0;
+  for (; *text != 0; ++text) {
+    const auto c = static_cast<unsigned char>(*text);
+    if (c == '\n') {
+      pen_x = 0;
+    } else {
+      pen_x += advance_width(c, size);
+      width = std::max(width, pen_x);
+    }
+  }
+  return (width + ONE / 2) >> FRAC_BITS;
+}
+
+extern "C" void sdf_font_draw_text(fb_t* fb,
+                                   const sdf_font_t* font,
+                                   int x,
+                                   int y,
+                                   int size,
+                                   const char* text,
+                                   uint32_t color) {
+  if (size < 1 || font->pixels == nullptr) {
+    return;
+  }
+  switch (fb->mode) {
+    case CMODE_RGBA8888:
+      draw_text<CMODE_RGBA8888>(fb, font, x, y, size, text, color);
+      break;
+    case CMODE_RGBA5551:
+      draw_text<CMODE_RGBA5551>(fb, font, x, y, size, text, color);
+      break;
+    case CMODE_PAL8:
+      draw_text<CMODE_PAL8>(fb, font, x, y, size, text, color);
+      break;
+    case CMODE_PAL4:
+      draw_text<CMODE_PAL4>(fb, font, x, y, size, text, color);
+      break;
+    case CMODE_PAL2:
+      draw_text<CMODE_PAL2>(fb, font, x, y, size, text, color);
+      break;
+    case CMODE_PAL1:
+      draw_text<CMODE_PAL1>(fb, font, x, y, size, text, color);
+      break;
+    default:
+      break;
+  }
+}
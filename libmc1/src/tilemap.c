@@ -0,0 +1,273 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2020 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <mc1/tilemap.h>
+
+#include <mc1/memory.h>
+#include <mc1/mmio.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+//--------------------------------------------------------------------------------------------------
+// Private.
+//--------------------------------------------------------------------------------------------------
+
+// Floor division and modulo (the result of mod() is always non-negative).
+static int floor_div(const int a, const int b) {
+  return (a >= 0) ? (a / b) : -((b - 1 - a) / b);
+}
+
+static int mod(const int a, const int b) {
+  const int r = a % b;
+  return (r < 0) ? (r + b) : r;
+}
+
+static uint16_t* get_cell(const tilemap_t* tm, const int col, const int row) {
+  return &tm->map[mod(row, tm->map_h) * tm->map_w + mod(col, tm->map_w)];
+}
+
+// Get the ring buffer word offset of the world coordinate (word column xw, pixel row y).
+static size_t ring_offset(const tilemap_t* tm, const int xw, const int y) {
+  const int ring_rows = (int)(tm->ring_size / tm->ring_stride);
+  size_t offset = (size_t)mod(y, ring_rows) * tm->ring_stride + (size_t)mod(xw, (int)tm->ring_size);
+  if (offset >= tm->ring_size) {
+    offset -= tm->ring_size;
+  }
+  return offset;
+}
+
+static void draw_tile(tilemap_t* tm, const int col, const int row) {
+  const int index = (int)(*get_cell(tm, col, row) & ~TILEMAP_DIRTY);
+
+  // Look up the tile in the tile set. Tiles outside of the tile set are drawn as zero pixels, so
+  // that the ring buffer slot does not keep the previous tile.
+  const fb_t* tiles = tm->tiles;
+  const int log2ppw = tm->mode;
+  const int tile_words = tm->tile_w >> log2ppw;
+  const int src_y = (index / tm->tiles_per_row) * tm->tile_h;
+  const uint8_t* src = NULL;
+  if (src_y + tm->tile_h <= tiles->height) {
+    src = (const uint8_t*)tiles->pixels + (size_t)src_y * tiles->stride +
+          (size_t)((index % tm->tiles_per_row) * tile_words) * 4u;
+  }
+
+  // Copy the tile rows to the ring buffer. Since the ring buffer stride is a multiple of the tile
+  // width, a tile row never wraps around the end of the ring buffer. Rows that are written to the
+  // start of the ring buffer are also written to the guard area after the ring buffer, so that
+  // video rows that start near the end of the ring buffer can be read contiguously.
+  const int xw = col * tile_words;
+  const size_t num_bytes = (size_t)tile_words * 4u;
+  for (int y = row * tm->tile_h, y_end = y + tm->tile_h; y < y_end; ++y) {
+    const size_t offset = ring_offset(tm, xw, y);
+    if (src != NULL) {
+      memcpy(&tm->ring[offset], src, num_bytes);
+      if (offset < tm->ring_stride) {
+        memcpy(&tm->ring[tm->ring_size + offset], src, num_bytes);
+      }
+      src += tiles->stride;
+    } else {
+      memset(&tm->ring[offset], 0, num_bytes);
+      if (offset < tm->ring_stride) {
+        memset(&tm->ring[tm->ring_size + offset], 0, num_bytes);
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Public.
+//--------------------------------------------------------------------------------------------------
+
+tilemap_t* tilemap_create(int view_w,
+                          int view_h,
+                          const fb_t* tiles,
+                          int tile_w,
+                          int tile_h,
+                          int map_w,
+                          int map_h) {
+  // Sanity check input parameters.
+  if (tiles == NULL || tiles->mode < CMODE_RGBA8888 || tiles->mode > CMODE_PAL1) {
+    return NULL;
+  }
+  const int mode = tiles->mode;
+  const int ppw = 1 << mode;
+  if (view_w < 1 || view_h < 1 || tile_w < 1 || tile_h < 1 || (tile_w % ppw) != 0 ||
+      tile_w > tiles->width || tile_h > tiles->height || map_w < 1 || map_h < 1) {
+    return NULL;
+  }
+
+  // Calculate the ring buffer dimensions.
+  const int res_cols = (view_w + tile_w - 1) / tile_w + 1;
+  const int res_rows = (view_h + tile_h - 1) / tile_h + 1;
+  const size_t ring_stride = (size_t)(res_cols * tile_w) / (size_t)ppw;
+  const size_t ring_size = ring_stride * (size_t)(res_rows * tile_h);
+
+  // Allocate memory for the tile map object and the tile map (in XRAM).
+  const size_t map_size = sizeof(uint16_t) * (size_t)map_w * (size_t)map_h;
+  tilemap_t* tm = (tilemap_t*)malloc(sizeof(tilemap_t) + map_size);
+  if (!tm) {
+    return NULL;
+  }
+  memset(tm, 0, sizeof(tilemap_t) + map_size);
+
+  // Allocate memory for the VCP and the ring buffer (in VRAM).
+  const size_t pal_N = (mode >= CMODE_PAL8) ? (1u << (32 >> mode)) : 0u;
+  const size_t vcp_prologue_words = 2u + (pal_N > 0u ? 1u + pal_N : 0u);
+  const size_t vcp_words = vcp_prologue_words + 4u + 2u * (size_t)(view_h - 1) + 1u;
+  const size_t vram_size = vcp_words * 4u + (ring_size + ring_stride) * 4u;
+  tm->vcp = (uint32_t*)vmem_alloc(vram_size);
+  if (!tm->vcp) {
+    free(tm);
+    return NULL;
+  }
+  memset(tm->vcp, 0, vram_size);
+
+  // Populate the tilemap_t object fields.
+  tm->tiles = tiles;
+  tm->tile_w = tile_w;
+  tm->tile_h = tile_h;
+  tm->tiles_per_row = tiles->width / tile_w;
+  tm->map = (uint16_t*)&((uint8_t*)tm)[sizeof(tilemap_t)];
+  tm->map_w = map_w;
+  tm->map_h = map_h;
+  tm->ring = &tm->vcp[vcp_words];
+  tm->ring_stride = ring_stride;
+  tm->ring_size = ring_size;
+  tm->view_w = view_w;
+  tm->view_h = view_h;
+  tm->mode = mode;
+  tm->res_cols = res_cols;
+  tm->res_rows = res_rows;
+
+  // Get the native width and height of the video signal.
+  const uint32_t native_width = MMIO(VIDWIDTH);
+  const uint32_t native_height = MMIO(VIDHEIGHT);
+
+  uint32_t* vcp = tm->vcp;
+
+  // VCP prologue.
+  *vcp++ = vcp_emit_setreg(VCR_XINCR, (0x010000 * (uint32_t)view_w) / native_width);
+  *vcp++ = vcp_emit_setreg(VCR_CMODE, (uint32_t)mode);
+
+  // Palette.
+  if (pal_N > 0u) {
+    *vcp++ = vcp_emit_setpal(0, pal_N);
+    tm->palette = vcp;
+    for (uint32_t k = 0; k < pal_N; ++k) {
+      *vcp++ = ((k * 255u) / pal_N) * 0x01010101u;
+    }
+  }
+
+  // Address pointers (the XOFFS and ADDR values are set by tilemap_render()).
+  const uint32_t vcp_ring_addr = to_vcp_addr((uintptr_t)tm->ring);
+  *vcp++ = vcp_emit_waity(0);
+  *vcp++ = vcp_emit_setreg(VCR_HSTOP, native_width);
+  tm->vcp_rows = vcp;
+  *vcp++ = vcp_emit_setreg(VCR_XOFFS, 0);
+  *vcp++ = vcp_emit_setreg(VCR_ADDR, vcp_ring_addr);
+  for (int k = 1; k < view_h; ++k) {
+    uint32_t y = ((uint32_t)k * native_height) / (uint32_t)view_h;
+    *vcp++ = vcp_emit_waity((int)y);
+    *vcp++ = vcp_emit_setreg(VCR_ADDR, vcp_ring_addr);
+  }
+
+  // Wait forever.
+  *vcp++ = vcp_emit_waity(32767);
+
+  return tm;
+}
+
+void tilemap_destroy(tilemap_t* tm) {
+  if (tm != NULL) {
+    vmem_free(tm->vcp);
+    free(tm);
+  }
+}
+
+void tilemap_show(tilemap_t* tm, layer_t layer) {
+  vcp_set_prg(layer, tm->vcp);
+}
+
+void tilemap_set_tile(tilemap_t* tm, int col, int row, unsigned index) {
+  uint16_t* cell = get_cell(tm, col, row);
+  index &= ~TILEMAP_DIRTY;
+  if ((*cell & ~TILEMAP_DIRTY) != index) {
+    *cell = (uint16_t)(index | TILEMAP_DIRTY);
+    tm->any_dirty = 1;
+  }
+}
+
+unsigned tilemap_get_tile(const tilemap_t* tm, int col, int row) {
+  return *get_cell(tm, col, row) & ~TILEMAP_DIRTY;
+}
+
+void tilemap_render(tilemap_t* tm, int x, int y) {
+  // Determine which tiles need to be resident in the ring buffer.
+  const int col0 = floor_div(x, tm->tile_w);
+  const int row0 = floor_div(y, tm->tile_h);
+  const int old_col0 = tm->res_col;
+  const int old_row0 = tm->res_row;
+  const int old_valid = tm->valid;
+
+  // Draw the tiles that have been scrolled into view, or that have been changed.
+  if (!old_valid || col0 != old_col0 || row0 != old_row0 || tm->any_dirty) {
+    for (int row = row0; row < row0 + tm->res_rows; ++row) {
+      const int old_row = old_valid && row >= old_row0 && row < old_row0 + tm->res_rows;
+      for (int col = col0; col < col0 + tm->res_cols; ++col) {
+        const int old = old_row && col >= old_col0 && col < old_col0 + tm->res_cols;
+        if (!old || (*get_cell(tm, col, row) & TILEMAP_DIRTY) != 0u) {
+          draw_tile(tm, col, row);
+        }
+      }
+    }
+
+    // Clear the dirty flags in a separate pass, since a map that is smaller than the ring buffer
+    // shows the same cell in several ring buffer slots, and all of them must be redrawn.
+    if (tm->any_dirty) {
+      for (int row = row0; row < row0 + tm->res_rows; ++row) {
+        for (int col = col0; col < col0 + tm->res_cols; ++col) {
+          *get_cell(tm, col, row) &= (uint16_t)~TILEMAP_DIRTY;
+        }
+      }
+    }
+    tm->res_col = col0;
+    tm->res_row = row0;
+    tm->valid = 1;
+    tm->any_dirty = 0;
+  }
+
+  // Update the VCP: The whole word part of the x coordinate is handled by the row addresses, and
+  // the remaining pixels are handled by XOFFS.
+  const int ppw = 1 << tm->mode;
+  const int xw = floor_div(x, ppw);
+  const uint32_t xoffs = (uint32_t)(x - xw * ppw) << 16;
+  uint32_t* vcp = tm->vcp_rows;
+  *vcp++ = vcp_emit_setreg(VCR_XOFFS, xoffs);
+  size_t offset = ring_offset(tm, xw, y);
+  for (int k = 0; k < tm->view_h; ++k) {
+    *vcp = vcp_emit_setreg(VCR_ADDR, to_vcp_addr((uintptr_t)&tm->ring[offset]));
+    vcp += 2;
+    offset += tm->ring_stride;
+    if (offset >= tm->ring_size) {
+      offset -= tm->ring_size;
+    }
+  }
+}
@@ -0,0 +1,344 @@
+// -*- mode: c; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2020 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <mc1/transform.h>
+
+// Note: The vector implementations below process the points in chunks of VL (the max vector
+// length) elements. The matrix elements are loaded into scalar registers inside the loop (rather
+// than being kept in registers across the loop) since there are not enough scalar registers to
+// hold an entire matrix plus all the pointers. The cost of the scalar loads is amortized over an
+// entire chunk of points. The rows are calculated in an interleaved fashion to avoid stalling on
+// FPU results.
+
+void transform_points(const float* m,
+                      const float* x,
+                      const float* y,
+                      const float* z,
+                      float* out_x,
+                      float* out_y,
+                      float* out_z,
+                      int count) {
+  if (count <= 0) {
+    return;
+  }
+
+#if defined(__MRISC32_VECTOR_OPS__) && defined(__MRISC32_HARD_FLOAT__)
+  float t0, t1, t2;
+  __asm volatile(
+      "getsr   vl, #0x10\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[count]\n\t"
+      "sub     %[count], %[count], vl\n\t"
+      "ldw     v1, %[x], #4\n\t"
+      "ldw     v2, %[y], #4\n\t"
+      "ldw     v3, %[z], #4\n\t"
+      "ldea    %[x], %[x], vl*4\n\t"
+      "ldea    %[y], %[y], vl*4\n\t"
+      "ldea    %[z], %[z], vl*4\n\t"
+
+      // x-terms.
+      "ldw     %[t0], %[m], #0\n\t"
+      "ldw     %[t1], %[m], #16\n\t"
+      "ldw     %[t2], %[m], #32\n\t"
+      "fmul    v4, v1, %[t0]\n\t"
+      "fmul    v5, v1, %[t1]\n\t"
+      "fmul    v6, v1, %[t2]\n\t"
+
+      // y-terms.
+      "ldw     %[t0], %[m], #4\n\t"
+      "ldw     %[t1], %[m], #20\n\t"
+      "ldw     %[t2], %[m], #36\n\t"
+      "fmul    v7, v2, %[t0]\n\t"
+      "fmul    v8, v2, %[t1]\n\t"
+      "fmul    v9, v2, %[t2]\n\t"
+      "fadd    v4, v4, v7\n\t"
+      "fadd    v5, v5, v8\n\t"
+      "fadd    v6, v6, v9\n\t"
+
+      // z-terms.
+      "ldw     %[t0], %[m], #8\n\t"
+      "ldw     %[t1], %[m], #24\n\t"
+      "ldw     %[t2], %[m], #40\n\t"
+      "fmul    v7, v3, %[t0]\n\t"
+      "fmul    v8, v3, %[t1]\n\t"
+      "fmul    v9, v3, %[t2]\n\t"
+      "fadd    v4, v4, v7\n\t"
+      "fadd    v5, v5, v8\n\t"
+      "fadd    v6, v6, v9\n\t"
+
+      // Translation.
+      "ldw     %[t0], %[m], #12\n\t"
+      "ldw     %[t1], %[m], #28\n\t"
+      "ldw     %[t2], %[m], #44\n\t"
+      "fadd    v4, v4, %[t0]\n\t"
+      "fadd    v5, v5, %[t1]\n\t"
+      "fadd    v6, v6, %[t2]\n\t"
+
+      "stw     v4, %[out_x], #4\n\t"
+      "stw     v5, %[out_y], #4\n\t"
+      "stw     v6, %[out_z], #4\n\t"
+      "ldea    %[out_x], %[out_x], vl*4\n\t"
+      "ldea    %[out_y], %[out_y], vl*4\n\t"
+      "ldea    %[out_z], %[out_z], vl*4\n\t"
+      "bgt     %[count], 1b"
+      : [ x ] "+r"(x),
+        [ y ] "+r"(y),
+        [ z ] "+r"(z),
+        [ out_x ] "+r"(out_x),
+        [ out_y ] "+r"(out_y),
+        [ out_z ] "+r"(out_z),
+        [ count ] "+r"(count),
+        [ t0 ] "=&r"(t0),
+        [ t1 ] "=&r"(t1),
+        [ t2 ] "=&r"(t2)
+      : [ m ] "r"(m)
+      : "vl", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "memory");
+#else
+  // Note: Cache the matrix in locals, since the compiler can not assume that the output arrays do
+  // not alias the matrix.
+  const float m0 = m[0], m1 = m[1], m2 = m[2], m3 = m[3];
+  const float m4 = m[4], m5 = m[5], m6 = m[6], m7 = m[7];
+  const float m8 = m[8], m9 = m[9], m10 = m[10], m11 = m[11];
+  for (int i = 0; i < count; ++i) {
+    const float px = x[i];
+    const float py = y[i];
+    const float pz = z[i];
+    out_x[i] = m0 * px + m1 * py + m2 * pz + m3;
+    out_y[i] = m4 * px + m5 * py + m6 * pz + m7;
+    out_z[i] = m8 * px + m9 * py + m10 * pz + m11;
+  }
+#endif
+}
+
+void project_points(const float* m,
+                    const float* x,
+                    const float* y,
+                    const float* z,
+                    float* out_x,
+                    float* out_y,
+                    float* out_inv_w,
+                    int count) {
+  if (count <= 0) {
+    return;
+  }
+
+#if defined(__MRISC32_VECTOR_OPS__) && defined(__MRISC32_HARD_FLOAT__)
+  float t0, t1, t2;
+  __asm volatile(
+      "getsr   vl, #0x10\n\t"
+      "mov     v10, %[one]\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[count]\n\t"
+      "sub     %[count], %[count], vl\n\t"
+      "ldw     v1, %[x], #4\n\t"
+      "ldw     v2, %[y], #4\n\t"
+      "ldw     v3, %[z], #4\n\t"
+      "ldea    %[x], %[x], vl*4\n\t"
+      "ldea    %[y], %[y], vl*4\n\t"
+      "ldea    %[z], %[z], vl*4\n\t"
+
+      // x-terms (rows 0, 1 and 3).
+      "ldw     %[t0], %[m], #0\n\t"
+      "ldw     %[t1], %[m], #16\n\t"
+      "ldw     %[t2], %[m], #48\n\t"
+      "fmul    v4, v1, %[t0]\n\t"
+      "fmul    v5, v1, %[t1]\n\t"
+      "fmul    v6, v1, %[t2]\n\t"
+
+      // y-terms.
+      "ldw     %[t0], %[m], #4\n\t"
+      "ldw     %[t1], %[m], #20\n\t"
+      "ldw     %[t2], %[m], #52\n\t"
+      "fmul    v7, v2, %[t0]\n\t"
+      "fmul    v8, v2, %[t1]\n\t"
+      "fmul    v9, v2, %[t2]\n\t"
+      "fadd    v4, v4, v7\n\t"
+      "fadd    v5, v5, v8\n\t"
+      "fadd    v6, v6, v9\n\t"
+
+      // z-terms.
+      "ldw     %[t0], %[m], #8\n\t"
+      "ldw     %[t1], %[m], #24\n\t"
+      "ldw     %[t2], %[m], #56\n\t"
+      "fmul    v7, v3, %[t0]\n\t"
+      "fmul    v8, v3, %[t1]\n\t"
+      "fmul    v9, v3, %[t2]\n\t"
+      "fadd    v4, v4, v7\n\t"
+      "fadd    v5, v5, v8\n\t"
+      "fadd    v6, v6, v9\n\t"
+
+      // Translation.
+      "ldw     %[t0], %[m], #12\n\t"
+      "ldw     %[t1], %[m], #28\n\t"
+      "ldw     %[t2], %[m], #60\n\t"
+      "fadd    v4, v4, %[t0]\n\t"
+      "fadd    v5, v5, %[t1]\n\t"
+      "fadd    v6, v6, %[t2]\n\t"
+
+      // Perspective division.
+      "fdiv    v6, v10, v6\n\t"
+      "fmul    v4, v4, v6\n\t"
+      "fmul    v5, v5, v6\n\t"
+
+      "stw     v4, %[out_x], #4\n\t"
+      "stw     v5, %[out_y], #4\n\t"
+      "stw     v6, %[out_inv_w], #4\n\t"
+      "ldea    %[out_x], %[out_x], vl*4\n\t"
+      "ldea    %[out_y], %[out_y], vl*4\n\t"
+      "ldea    %[out_inv_w], %[out_inv_w], vl*4\n\t"
+      "bgt     %[count], 1b"
+      : [ x ] "+r"(x),
+        [ y ] "+r"(y),
+        [ z ] "+r"(z),
+        [ out_x ] "+r"(out_x),
+        [ out_y ] "+r"(out_y),
+        [ out_inv_w ] "+r"(out_inv_w),
+        [ count ] "+r"(count),
+        [ t0 ] "=&r"(t0),
+        [ t1 ] "=&r"(t1),
+        [ t2 ] "=&r"(t2)
+      : [ m ] "r"(m), [ one ] "r"(1.0f)
+      : "vl", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "memory");
+#else
+  const float m0 = m[0], m1 = m[1], m2 = m[2], m3 = m[3];
+  const float m4 = m[4], m5 = m[5], m6 = m[6], m7 = m[7];
+  const float m12 = m[12], m13 = m[13], m14 = m[14], m15 = m[15];
+  for (int i = 0; i < count; ++i) {
+    const float px = x[i];
+    const float py = y[i];
+    const float pz = z[i];
+    const float inv_w = 1.0f / (m12 * px + m13 * py + m14 * pz + m15);
+    out_x[i] = (m0 * px + m1 * py + m2 * pz + m3) * inv_w;
+    out_y[i] = (m4 * px + m5 * py + m6 * pz + m7) * inv_w;
+    out_inv_w[i] = inv_w;
+  }
+#endif
+}
+
+void clip_codes(const float* m,
+                const float* x,
+                const float* y,
+                const float* z,
+                uint8_t* codes,
+                int count) {
+  if (count <= 0) {
+    return;
+  }
+
+#if defined(__MRISC32_VECTOR_OPS__) && defined(__MRISC32_HARD_FLOAT__)
+  // The clip space coordinates are calculated one row at a time, and each row is compared against
+  // w and -w. The comparisons produce all-ones masks that are and:ed with the clip code bits.
+  const float* row;
+  uint32_t bit, t0;
+  float w0, w1, w2, w3;
+  __asm volatile(
+      "getsr   vl, #0x10\n"
+
+      "1:\n\t"
+      "min     vl, vl, %[count]\n\t"
+      "sub     %[count], %[count], vl\n\t"
+      "ldw     v1, %[x], #4\n\t"
+      "ldw     v2, %[y], #4\n\t"
+      "ldw     v3, %[z], #4\n\t"
+      "ldea    %[x], %[x], vl*4\n\t"
+      "ldea    %[y], %[y], vl*4\n\t"
+      "ldea    %[z], %[z], vl*4\n\t"
+
+      // w (row 3), and -w.
+      "ldw     %[w0], %[m], #48\n\t"
+      "ldw     %[w1], %[m], #52\n\t"
+      "ldw     %[w2], %[m], #56\n\t"
+      "ldw     %[w3], %[m], #60\n\t"
+      "fmul    v4, v1, %[w0]\n\t"
+      "fmul    v5, v2, %[w1]\n\t"
+      "fmul    v6, v3, %[w2]\n\t"
+      "fadd    v4, v4, v5\n\t"
+      "fadd    v4, v4, v6\n\t"
+      "fadd    v4, v4, %[w3]\n\t"
+      "fmul    v5, v4, %[minus_one]\n\t"
+      "mov     v10, z\n\t"
+
+      // Rows 0, 1 and 2 (x, y and z).
+      "mov     %[row], %[m]\n\t"
+      "ldi     %[bit], #1\n"
+      "2:\n\t"
+      "ldw     %[w0], %[row], #0\n\t"
+      "ldw     %[w1], %[row], #4\n\t"
+      "ldw     %[w2], %[row], #8\n\t"
+      "ldw     %[w3], %[row], #12\n\t"
+      "fmul    v6, v1, %[w0]\n\t"
+      "fmul    v7, v2, %[w1]\n\t"
+      "fmul    v8, v3, %[w2]\n\t"
+      "fadd    v6, v6, v7\n\t"
+      "fadd    v6, v6, v8\n\t"
+      "fadd    v6, v6, %[w3]\n\t"
+      "fslt    v7, v6, v5\n\t"  // c < -w
+      "fslt    v8, v4, v6\n\t"  // c > w
+      "and     v7, v7, %[bit]\n\t"
+      "lsl     %[bit], %[bit], #1\n\t"
+      "and     v8, v8, %[bit]\n\t"
+      "lsl     %[bit], %[bit], #1\n\t"
+      "or      v10, v10, v7\n\t"
+      "or      v10, v10, v8\n\t"
+      "add     %[row], %[row], #16\n\t"
+      "slt     %[t0], %[bit], #64\n\t"
+      "bs      %[t0], 2b\n\t"
+
+      "stb     v10, %[codes], #1\n\t"
+      "add     %[codes], %[codes], vl\n\t"
+      "bgt     %[count], 1b"
+      : [ x ] "+r"(x),
+        [ y ] "+r"(y),
+        [ z ] "+r"(z),
+        [ codes ] "+r"(codes),
+        [ count ] "+r"(count),
+        [ row ] "=&r"(row),
+        [ bit ] "=&r"(bit),
+        [ t0 ] "=&r"(t0),
+        [ w0 ] "=&r"(w0),
+        [ w1 ] "=&r"(w1),
+        [ w2 ] "=&r"(w2),
+        [ w3 ] "=&r"(w3)
+      : [ m ] "r"(m), [ minus_one ] "r"(-1.0f)
+      : "vl", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v10", "memory");
+#else
+  for (int i = 0; i < count; ++i) {
+    const float px = x[i];
+    const float py = y[i];
+    const float pz = z[i];
+    const float w = m[12] * px + m[13] * py + m[14] * pz + m[15];
+    const float minus_w = -w;
+    uint8_t code = 0;
+    const float* row = m;
+    for (uint8_t bit = CLIP_LEFT; bit < 64; bit <<= 2, row += 4) {
+      const float c = row[0] * px + row[1] * py + row[2] * pz + row[3];
+      if (c < minus_w) {
+        code |= bit;
+      }
+      if (c > w) {
+        code |= bit << 1;
+      }
+    }
+    codes[i] = code;
+  }
+#endif
+}
@@ -305,6 +305,21 @@ lzg_uint32_t LZG_Decode(const unsigned char *in, lzg_uint32_t insize,
                         unsigned char *out, lzg_uint32_t outsize);
 
 
+/**
+* Determine the margin that is required for decoding LZG coded data in place.
+* For in place decoding, the coded data is placed at the end of a buffer of
+* (decoded size + margin) bytes, and the data is decoded to the start of the
+* same buffer. The margin guarantees that the decoder never overwrites coded
+* data that it has not read yet.
+* @param[in] in Input (compressed) buffer.
+* @param[in] insize Size of the input buffer (number of bytes).
+* @return The required margin (number of bytes), or zero if no margin is
+*         required or if the function failed (e.g. if the magic header ID
+*         could not be found).
+*/
+lzg_uint32_t LZG_InPlaceMargin(const unsigned char *in, lzg_uint32_t insize);
+
+
 /**
 * Get the version of the LZG library.
 * @return The version of the LZG library, on the same format as
@@ -249,3 +249,84 @@ unsigned int LZG_Decode(const unsigned char *in, lzg_uint32_t insize,
     /* Return size of decompressed buffer */
     return decodedSize;
 }
+
+lzg_uint32_t LZG_InPlaceMargin(const unsigned char *in, lzg_uint32_t insize)
+{
+    const unsigned char *src, *inEnd;
+    unsigned char symbol, b, marker1, marker2, marker3, marker4;
+    lzg_uint32_t length, decodedSize;
+    lzg_int32_t written, maxLead;
+
+    /* Does the input buffer at least contain the header? */
+    if (insize < LZG_HEADER_SIZE)
+        return 0;
+
+    /* Check magic number */
+    if ((in[0] != 'L') || (in[1] != 'Z') || (in[2] != 'G'))
+        return 0;
+    decodedSize = _LZG_GetUINT32(in, 3);
+
+    /* The input is placed at offset (decodedSize + margin - insize) of the
+       output buffer. After each token, the number of written bytes must not
+       exceed that offset plus the number of read bytes (i.e. the output must
+       not overwrite input that has not been read yet). maxLead keeps track of
+       the largest (written - read) difference. */
+    src = in + LZG_HEADER_SIZE;
+    inEnd = in + insize;
+    written = 0;
+    maxLead = 0;
+
+    if (in[15] == LZG_METHOD_LZG1)
+    {
+        if ((src + 4) > inEnd)
+            return 0;
+        marker1 = *src++;
+        marker2 = *src++;
+        marker3 = *src++;
+        marker4 = *src++;
+
+        while (src < inEnd)
+        {
+            symbol = *src++;
+            length = 1;
+            if ((symbol == marker1) || (symbol == marker2) ||
+                (symbol == marker3) || (symbol == marker4))
+            {
+                if (src >= inEnd)
+                    return 0;
+                b = *src++;
+                if (b)
+                {
+                    if (symbol == marker1)
+                    {
+                        length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
+                        src += 2;
+                    }
+                    else if (symbol == marker2)
+                    {
+                        length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
+                        src += 1;
+                    }
+                    else if (symbol == marker3)
+                        length = (b >> 6) + 3;
+                    else
+                        length = _LZG_LENGTH_DECODE_LUT[b & 0x1f];
+                }
+            }
+            written += (lzg_int32_t)length;
+            if (written - (lzg_int32_t)(src - in) > maxLead)
+                maxLead = written - (lzg_int32_t)(src - in);
+        }
+    }
+    else
+    {
+        /* Plain copy: the output is never ahead of the input. */
+        written = (lzg_int32_t)decodedSize;
+    }
+
+    /* The input must also fit in the buffer, i.e. the margin must be at
+       least (insize - decodedSize). */
+    if (maxLead + (lzg_int32_t)insize - (lzg_int32_t)decodedSize < 0)
+        return 0;
+    return (lzg_uint32_t)(maxLead + (lzg_int32_t)insize - (lzg_int32_t)decodedSize);
+}
@@ -0,0 +1,293 @@
+// -*- mode: c++; tab-width: 2; indent-tabs-mode: nil; -*-
+//--------------------------------------------------------------------------------------------------
+// Copyright (c) 2021 Marcus Geelnard
+//
+// This software is provided 'as-is', without any express or implied warranty. In no event will the
+// authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose, including commercial
+// applications, and to alter it and redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not claim that you wrote
+//     the original software. If you use this software in a product, an acknowledgment in the
+//     product documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be misrepresented as
+//     being the original software.
+//
+//  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+#include <mc1/glyph_font.h>
+
+#include <lzg.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// SDF font atlas
+// --------------
+//
+// The atlas is an MCI image (see png2mci) in the PAL8 pixel format with a grayscale palette. It
+// holds the glyphs of the characters SDF_FIRST_CHAR to SDF_FIRST_CHAR + SDF_NUM_CHARS - 1 of the
+// built in vector font, in a grid of SDF_ATLAS_COLUMNS cells per row. Each cell is N x N pixels,
+// and the cell size is given by the image width (N = width / SDF_ATLAS_COLUMNS).
+//
+// Each pixel holds the signed distance from the pixel center to the glyph edge:
+//
+//   value = SDF_EDGE_VALUE + SDF_DIST_SCALE * (distance to the edge, in pixels)
+//
+// ...where the distance is positive inside the glyph and negative outside the glyph, and the value
+// is clamped to [0, 255].
+//--------------------------------------------------------------------------------------------------
+
+namespace {
+
+using namespace mc1::glyph_font;
+
+// Pixel format and compression methods (same as in png2mci).
+const uint32_t PIXFMT_PAL8 = 2;
+const uint32_t COMP_NONE = 0;
+const uint32_t COMP_LZG = 1;
+
+// Stroke radius, in font grid units (1/8 of the cell size).
+const float STROKE_RADIUS = 0.35f;
+
+// Number of line segments per Bézier curve.
+const int BEZIER_SEGMENTS = 16;
+
+struct segment_t {
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+};
+
+// Get the stroke center lines of a glyph, in font grid units.
+std::vector<segment_t> get_segments(const unsigned c) {
+  std::vector<segment_t> segments;
+  if (FONT_INDEX.offset[c] == NO_GLYPH) {
+    return segments;
+  }
+
+  // Same point layout as in glyph_renderer_t: grid point (0, 0) is one grid unit from the top left
+  // corner of the cell.
+  const auto get_x = [](const uint8_t p) { return static_cast<float>(((p >> 3) & 7u) + 1u); };
+  const auto get_y = [](const uint8_t p) { return static_cast<float>((p & 7u) + 1u); };
+  const auto get_kind = [](const uint8_t p) { return static_cast<point_kind_t>((p >> 6) & 3u); };
+
+  const uint8_t* points = &FONT[FONT_INDEX.offset[c]];
+  uint8_t p1 = *points++;
+  while (get_kind(p1) != PNT_LAST) {
+    const uint8_t p2 = *points++;
+    if (get_kind(p2) == PNT_BEZIER) {
+      const uint8_t p3 = *points++;
+      float x = get_x(p1);
+      float y = get_y(p1);
+      for (int i = 1; i <= BEZIER_SEGMENTS; ++i) {
+        const float t = static_cast<float>(i) / static_cast<float>(BEZIER_SEGMENTS);
+        const float w1 = (1.0f - t) * (1.0f - t);
+        const float w2 = 2.0f * t * (1.0f - t);
+        const float w3 = t * t;
+        const float nx = w1 * get_x(p1) + w2 * get_x(p2) + w3 * get_x(p3);
+        const float ny = w1 * get_y(p1) + w2 * get_y(p2) + w3 * get_y(p3);
+        segments.push_back(segment_t{x, y, nx, ny});
+        x = nx;
+        y = ny;
+      }
+      p1 = p3;
+    } else {
+      segments.push_back(segment_t{get_x(p1), get_y(p1), get_x(p2), get_y(p2)});
+      p1 = p2;
+    }
+    if (get_kind(p1) == PNT_END) {
+      p1 = *points++;
+    }
+  }
+  return segments;
+}
+
+float distance_to_segment(const float x, const float y, const segment_t& s) {
+  const float dx = s.x1 - s.x0;
+  const float dy = s.y1 - s.y0;
+  const float len2 = dx * dx + dy * dy;
+  float t = 0.0f;
+  if (len2 > 0.0f) {
+    t = std::clamp(((x - s.x0) * dx + (y - s.y0) * dy) / len2, 0.0f, 1.0f);
+  }
+  const float ex = x - (s.x0 + t * dx);
+  const float ey = y - (s.y0 + t * dy);
+  return std::sqrt(ex * ex + ey * ey);
+}
+
+void render_glyph(const unsigned c,
+                  const unsigned cell_size,
+                  uint8_t* pixels,
+                  const unsigned stride) {
+  const auto segments = get_segments(c);
+  const float grid_size = static_cast<float>(cell_size) / 8.0f;
+  for (unsigned y = 0; y < cell_size; ++y) {
+    for (unsigned x = 0; x < cell_size; ++x) {
+      // Find the distance from the pixel center to the closest stroke center line.
+      const float gx = (static_cast<float>(x) + 0.5f) / grid_size;
+      const float gy = (static_cast<float>(y) + 0.5f) / grid_size;
+      float dist = 8.0f;
+      for (const auto& s : segments) {
+        dist = std::min(dist, distance_to_segment(gx, gy, s));
+      }
+
+      // Convert to a signed distance (in pixels) from the stroke edge.
+      const float edge_dist = (STROKE_RADIUS - dist) * grid_size;
+      const float value = static_cast<float>(SDF_EDGE_VALUE) +
+                          static_cast<float>(SDF_DIST_SCALE) * edge_dist;
+      pixels[y * stride + x] = static_cast<uint8_t>(std::clamp(std::lround(value), 0L, 255L));
+    }
+  }
+}
+
+std::vector<uint8_t> compress(const std::vector<uint8_t>& data) {
+  lzg_uint32_t max_enc_size = LZG_MaxEncodedSize(static_cast<lzg_uint32_t>(data.size()));
+  std::vector<uint8_t> enc_buf(max_enc_size);
+  lzg_encoder_config_t config;
+  LZG_InitEncoderConfig(&config);
+  config.level = LZG_LEVEL_9;
+  lzg_uint32_t enc_size = LZG_Encode(data.data(),
+                                     static_cast<lzg_uint32_t>(data.size()),
+                                     enc_buf.data(),
+                                     max_enc_size,
+                                     &config);
+  if (enc_size == 0u) {
+    fprintf(stderr, "liblzg: Compression failed!\n");
+    exit(1);
+  }
+  enc_buf.resize(enc_size);
+  return enc_buf;
+}
+
+void write_uint8(const uint32_t x, FILE* f) {
+  uint8_t buf[1] = {static_cast<uint8_t>(x)};
+  (void)fwrite(&buf[0], 1, 1, f);
+}
+
+void write_uint16(const uint32_t x, FILE* f) {
+  uint8_t buf[2] = {static_cast<uint8_t>(x), static_cast<uint8_t>(x >> 8)};
+  (void)fwrite(&buf[0], 1, 2, f);
+}
+
+void write_uint32(const uint32_t x, FILE* f) {
+  uint8_t buf[4] = {static_cast<uint8_t>(x),
+                    static_cast<uint8_t>(x >> 8),
+                    static_cast<uint8_t>(x >> 16),
+                    static_cast<uint8_t>(x >> 24)};
+  (void)fwrite(&buf[0], 1, 4, f);
+}
+
+void write_atlas(const unsigned width,
+                 const unsigned height,
+                 const uint32_t comp_mode,
+                 const std::vector<uint8_t>& pixels,
+                 FILE* f) {
+  // Write the header.
+  write_uint32(0x3149434du, f);                           // Magic ID
+  write_uint16(width, f);                                 // Image width
+  write_uint16(height, f);                                // Image height
+  write_uint8(PIXFMT_PAL8, f);                            // Pixel format
+  write_uint8(comp_mode, f);                              // Compression method
+  write_uint16(256, f);                                   // Number of palette colors
+  write_uint32(static_cast<uint32_t>(pixels.size()), f);  // Pixel data size (in bytes)
+
+  // Write a grayscale palette (so that the atlas can be viewed as an image).
+  for (uint32_t i = 0; i < 256; ++i) {
+    write_uint32(0xff000000u | (i * 0x010101u), f);
+  }
+
+  // Write the pixel data.
+  fwrite(pixels.data(), 1, pixels.size(), f);
+}
+
+void print_usage(const char* prg_name) {
+  fprintf(stderr, "Usage: %s [options] [MCIFILE]\n\n", prg_name);
+  fprintf(stderr, "  MCIFILE     - The name of the MCI file (optional)\n");
+  fprintf(stderr, "\nOptions:\n");
+  fprintf(stderr, "  --cell N    - Glyph cell size in pixels, 8-64 (default: 24)\n");
+  fprintf(stderr, "  --nocomp    - Use no compression (default)\n");
+  fprintf(stderr, "  --lzg       - Use LZG compression\n");
+  fprintf(stderr, "  --help      - Show this help text\n");
+  fprintf(stderr, "\nGenerate a signed distance field atlas of the built in vector font.\n");
+  fprintf(stderr, "If MCIFILE is not given, the atlas is written to stdout.\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Parse command line arguments.
+  unsigned cell_size = 24;
+  uint32_t comp_mode = COMP_NONE;
+  const char* mci_file_name = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      exit(0);
+    } else if (strcmp(arg, "--cell") == 0 && i + 1 < argc) {
+      cell_size = static_cast<unsigned>(atoi(argv[++i]));
+      if (cell_size < 8 || cell_size > 64) {
+        fprintf(stderr, "Invalid cell size: %s\n", argv[i]);
+        exit(1);
+      }
+    } else if (strcmp(arg, "--nocomp") == 0) {
+      comp_mode = COMP_NONE;
+    } else if (strcmp(arg, "--lzg") == 0) {
+      comp_mode = COMP_LZG;
+    } else if (arg[0] == '-') {
+      fprintf(stderr, "Unrecognized option: %s\n", arg);
+      print_usage(argv[0]);
+      exit(1);
+    } else if (mci_file_name == nullptr) {
+      mci_file_name = arg;
+    } else {
+      fprintf(stderr, "Unrecognized argument: %s\n", arg);
+      print_usage(argv[0]);
+      exit(1);
+    }
+  }
+
+  // Render the glyphs into the atlas. The row stride is a multiple of 32 bits.
+  const unsigned rows = (SDF_NUM_CHARS + SDF_ATLAS_COLUMNS - 1) / SDF_ATLAS_COLUMNS;
+  const unsigned width = SDF_ATLAS_COLUMNS * cell_size;
+  const unsigned height = rows * cell_size;
+  const unsigned stride = (width + 3u) & ~3u;
+  std::vector<uint8_t> pixels(static_cast<size_t>(stride) * height, 0u);
+  for (unsigned i = 0; i < SDF_NUM_CHARS; ++i) {
+    const unsigned cell_x = (i % SDF_ATLAS_COLUMNS) * cell_size;
+    const unsigned cell_y = (i / SDF_ATLAS_COLUMNS) * cell_size;
+    render_glyph(SDF_FIRST_CHAR + i, cell_size, &pixels[cell_y * stride + cell_x], stride);
+  }
+
+  // Compress the atlas.
+  if (comp_mode == COMP_LZG) {
+    pixels = compress(pixels);
+  }
+
+  // Write the MCI image.
+  FILE* out_file = stdout;
+  if (mci_file_name != nullptr) {
+    out_file = fopen(mci_file_name, "wb");
+    if (out_file == nullptr) {
+      fprintf(stderr, "Error: Unable to open %s for writing.\n", mci_file_name);
+      exit(1);
+    }
+  }
+  write_atlas(width, height, comp_mode, pixels, out_file);
+  if (mci_file_name != nullptr) {
+    fclose(out_file);
+  }
+
+  return 0;
+}